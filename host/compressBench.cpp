@@ -0,0 +1,148 @@
+/**
+ * @brief Host-side benchmark of the packet compressor
+ *
+ * Takes the ensembles of every packet of a session file, as the recorder
+ * hands them to the compressor, and times compressing them the way the
+ * recorder does, one record sized chunk per call, and decompressing them
+ * again.  Every packet must decompress to its ensembles.
+ */
+#include "sessionFile.hpp"
+
+#include <chrono>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+
+#define BENCH_N_REPEATS 20
+
+typedef std::vector<uint8_t> BENCH_Block_t;
+
+static void BENCH_printUsage(const char* name)
+{
+    printf("Usage: %s [-c chunk_bytes] session_file\n", name);
+    printf("  -c  Bytes added to the compressor per call, default 20\n");
+}
+
+int main(int argc, char** argv)
+{
+    static uint8_t packet[REC_MAX_PACKET_SIZE];
+    static uint8_t ensembles[PKT_MAX_ENSEMBLES_LEN];
+    static uint8_t compressed[REC_MAX_PAYLOAD_SIZE];
+    std::vector<BENCH_Block_t> blocks;
+    std::vector<BENCH_Block_t> compressedBlocks;
+    std::chrono::steady_clock::time_point start, stop;
+    LZSS_Encoder_t encoder;
+    FILE* pFile;
+    size_t chunk = 20;
+    size_t nIn;
+    size_t i;
+    uint64_t rawBytes = 0, compressedBytes = 0;
+    double compressNs, decompressNs;
+    int packetLen;
+    int nEnsembles;
+    int repeat;
+    int nFailed = 0;
+    int opt;
+
+    while((opt = getopt(argc, argv, "c:h")) != -1)
+    {
+        switch(opt)
+        {
+        case 'c':
+            chunk = strtoul(optarg, NULL, 0);
+            if(!chunk)
+            {
+                chunk = 1;
+            }
+            break;
+        default:
+            BENCH_printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if(optind >= argc)
+    {
+        BENCH_printUsage(argv[0]);
+        return 1;
+    }
+    pFile = fopen(argv[optind], "rb");
+    if(!pFile)
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+    while((packetLen = PKT_read(pFile, packet)) != 0)
+    {
+        if(packetLen < 0 || (nEnsembles = PKT_getEnsembles(packet, ensembles)) <= 0)
+        {
+            continue;
+        }
+        blocks.push_back(BENCH_Block_t(ensembles, ensembles + nEnsembles));
+    }
+    fclose(pFile);
+    if(blocks.empty())
+    {
+        printf("No packets\n");
+        return 1;
+    }
+
+    // compress as the recorder does, stopping where the packet would fill
+    compressedBlocks.resize(blocks.size());
+    start = std::chrono::steady_clock::now();
+    for(repeat = 0; repeat < BENCH_N_REPEATS; repeat++)
+    {
+        for(i = 0; i < blocks.size(); i++)
+        {
+            LZSS_initEncoder(&encoder, compressed, sizeof(compressed));
+            for(nIn = 0; nIn < blocks[i].size(); )
+            {
+                nIn = nIn + chunk < blocks[i].size() ? nIn + chunk : blocks[i].size();
+                if(!LZSS_compress(&encoder, blocks[i].data(), nIn))
+                {
+                    break;
+                }
+            }
+            if(repeat == 0)
+            {
+                compressedBlocks[i].assign(compressed, compressed + LZSS_getLength(&encoder));
+                blocks[i].resize(encoder.inPos);
+                rawBytes += encoder.inPos;
+                compressedBytes += LZSS_getLength(&encoder);
+            }
+        }
+    }
+    stop = std::chrono::steady_clock::now();
+    compressNs = std::chrono::duration<double, std::nano>(stop - start).count() / BENCH_N_REPEATS;
+
+    start = std::chrono::steady_clock::now();
+    for(repeat = 0; repeat < BENCH_N_REPEATS; repeat++)
+    {
+        for(i = 0; i < blocks.size(); i++)
+        {
+            nEnsembles = LZSS_decompress(compressedBlocks[i].data(), compressedBlocks[i].size(),
+                ensembles, sizeof(ensembles));
+            if(repeat == 0 && (nEnsembles != (int) blocks[i].size() ||
+                memcmp(ensembles, blocks[i].data(), nEnsembles)))
+            {
+                nFailed++;
+            }
+        }
+    }
+    stop = std::chrono::steady_clock::now();
+    decompressNs = std::chrono::duration<double, std::nano>(stop - start).count() / BENCH_N_REPEATS;
+
+    printf("Packets:            %zu\n", blocks.size());
+    printf("Ensemble bytes:     %llu\n", (unsigned long long) rawBytes);
+    printf("Compressed bytes:   %llu (%.1f%%)\n", (unsigned long long) compressedBytes,
+        100.0 * compressedBytes / rawBytes);
+    printf("Compress:           %.1f MB/s, %.1f us per packet\n",
+        rawBytes * 1e3 / compressNs, compressNs / 1e3 / blocks.size());
+    printf("Decompress:         %.1f MB/s, %.1f us per packet\n",
+        rawBytes * 1e3 / decompressNs, decompressNs / 1e3 / blocks.size());
+    if(nFailed)
+    {
+        printf("%d packets did not decompress to their ensembles!\n", nFailed);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include "Particle.h"
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <thread>
+
+static const std::chrono::steady_clock::time_point HOST_bootTime = 
+    std::chrono::steady_clock::now();
+
+system_tick_t millis(void)
+{
+    return (system_tick_t) std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - HOST_bootTime).count();
+}
+
+unsigned long micros(void)
+{
+    return (unsigned long) std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - HOST_bootTime).count();
+}
+
+void delay(unsigned long ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void os_thread_yield(void)
+{
+    std::this_thread::yield();
+}
+
+int os_thread_create(os_thread_t* thread, const char* name, os_thread_prio_t priority,
+    os_thread_fn_t fun, void* thread_param, size_t stack_size)
+{
+    (void) thread; (void) name; (void) priority;
+    (void) fun; (void) thread_param; (void) stack_size;
+    return -1;
+}
+
+typedef struct HOST_Semaphore_
+{
+    unsigned count;
+    unsigned maxCount;
+}HOST_Semaphore_t;
+
+int os_semaphore_create(os_semaphore_t* semaphore, unsigned max_count, unsigned initial_count)
+{
+    HOST_Semaphore_t* pSemaphore = new HOST_Semaphore_t;
+
+    pSemaphore->count = initial_count;
+    pSemaphore->maxCount = max_count;
+    *semaphore = pSemaphore;
+    return 0;
+}
+
+int os_semaphore_take(os_semaphore_t semaphore, system_tick_t timeout, bool reserved)
+{
+    HOST_Semaphore_t* pSemaphore = (HOST_Semaphore_t*) semaphore;
+
+    (void) timeout; (void) reserved;
+    // no other thread could give it
+    if(0 == pSemaphore->count)
+    {
+        return -1;
+    }
+    pSemaphore->count--;
+    return 0;
+}
+
+int os_semaphore_give(os_semaphore_t semaphore, bool reserved)
+{
+    HOST_Semaphore_t* pSemaphore = (HOST_Semaphore_t*) semaphore;
+
+    (void) reserved;
+    if(pSemaphore->count >= pSemaphore->maxCount)
+    {
+        return -1;
+    }
+    pSemaphore->count++;
+    return 0;
+}
+
+SystemClass System;
+CloudClass Particle;
+EEPROMClass EEPROM;
+
+void SystemClass::sleep(const SystemSleepConfiguration& config)
+{
+    delay(config.sleepDuration_ms);
+}
+
+extern "C" int SF_OSAL_printf(const char* fmt, ...)
+{
+    va_list vargs;
+    int nBytes;
+    va_start(vargs, fmt);
+    nBytes = vprintf(fmt, vargs);
+    va_end(vargs);
+    return nBytes;
+}
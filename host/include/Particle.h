@@ -0,0 +1,373 @@
+#ifndef __HOST_PARTICLE_H__
+#define __HOST_PARTICLE_H__
+/**
+ * @brief Minimal Device OS shim for host builds of firmware modules
+ *
+ * Only the parts of the Particle API used by the host-buildable modules are
+ * provided here.  See host/README.md.
+ *
+ * Time, pins, timers and the fuel gauge are implemented by the platform file
+ * linked into each host tool: hostPlatform.cpp runs on the host clock, and
+ * simPlatform.cpp runs on a virtual clock.
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <string.h>
+// conio.hpp declares its own getline, hide the POSIX one
+#define getline __posix_getline
+#include <stdio.h>
+#undef getline
+
+#define retained
+
+typedef uint32_t system_tick_t;
+typedef uint8_t byte;
+
+#ifndef TRUE
+#define TRUE    1
+#endif
+#ifndef FALSE
+#define FALSE   0
+#endif
+
+system_tick_t millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void os_thread_yield(void);
+
+/*
+ * Pins
+ */
+typedef uint16_t pin_t;
+enum HostPins_
+{
+    D0, D1, D2, D3, D4, D5, D6, D7,
+    A0, A1, A2, A3, A4, A5, A6, A7,
+    B0, B1, B2, B3, B4, B5,
+    C0, C1, C2, C3, C4, C5,
+    RX, TX, WKP,
+    HOST_NUM_PINS
+};
+
+#define LOW     0
+#define HIGH    1
+
+typedef enum PinMode_
+{
+    INPUT,
+    OUTPUT,
+    INPUT_PULLUP,
+    INPUT_PULLDOWN,
+}PinMode;
+
+void pinMode(pin_t pin, PinMode mode);
+void digitalWrite(pin_t pin, uint8_t value);
+int32_t digitalRead(pin_t pin);
+
+/*
+ * Sleep
+ */
+enum class SystemSleepMode
+{
+    NONE,
+    STOP,
+    ULTRA_LOW_POWER,
+    HIBERNATE,
+};
+
+class SystemSleepConfiguration
+{
+    public:
+    SystemSleepConfiguration() : sleepMode(SystemSleepMode::NONE), sleepDuration_ms(0) {}
+    SystemSleepConfiguration& mode(SystemSleepMode mode)
+    {
+        this->sleepMode = mode;
+        return *this;
+    }
+    SystemSleepConfiguration& duration(system_tick_t ms)
+    {
+        this->sleepDuration_ms = ms;
+        return *this;
+    }
+
+    SystemSleepMode sleepMode;
+    system_tick_t sleepDuration_ms;
+};
+
+/**
+ * @brief Host System object, sleeps block the calling thread
+ *
+ */
+class SystemClass
+{
+    public:
+    void sleep(const SystemSleepConfiguration& config);
+};
+extern SystemClass System;
+
+class CloudClass
+{
+    public:
+    bool process(void) { return true; }
+};
+extern CloudClass Particle;
+
+/*
+ * Software timers
+ */
+/**
+ * @brief Software timer
+ *
+ * Timers are kept in a list, and the platform runs the callbacks of active
+ * timers as time passes.
+ */
+class Timer
+{
+    public:
+    typedef void (*timer_callback_fn)(void);
+
+    Timer(unsigned period, timer_callback_fn callback, bool oneShot = false) :
+        period(period), callback(callback), oneShot(oneShot), active(false),
+        nextTime(0), pNext(Timer::pFirst)
+    {
+        Timer::pFirst = this;
+    }
+    bool start(void)
+    {
+        this->active = true;
+        this->nextTime = millis() + this->period;
+        return true;
+    }
+    bool stop(void)
+    {
+        this->active = false;
+        return true;
+    }
+    bool isActive(void) const { return this->active; }
+
+    /**
+     * @brief Runs the callbacks of all active timers due at or before now
+     *
+     * @param now Current time
+     */
+    static void process(system_tick_t now);
+
+    unsigned period;
+    timer_callback_fn callback;
+    bool oneShot;
+    bool active;
+    system_tick_t nextTime;
+    Timer* pNext;
+    static Timer* pFirst;
+};
+
+/*
+ * Threads
+ */
+typedef void* os_thread_t;
+typedef uint8_t os_thread_prio_t;
+typedef void (*os_thread_fn_t)(void* param);
+
+#define OS_THREAD_PRIORITY_DEFAULT      2
+#define OS_THREAD_STACK_SIZE_DEFAULT    3072
+
+/**
+ * @brief Creates a thread
+ *
+ * Provided by the platform file.  hostPlatform.cpp does not support threads
+ * and always fails, simPlatform.cpp runs threads cooperatively whenever the
+ * main thread waits.
+ *
+ * @return int 0 if successful, otherwise nonzero
+ */
+int os_thread_create(os_thread_t* thread, const char* name, os_thread_prio_t priority,
+    os_thread_fn_t fun, void* thread_param, size_t stack_size);
+
+typedef void* os_mutex_t;
+inline int os_mutex_create(os_mutex_t* pMutex) { *pMutex = NULL; return 0; }
+inline int os_mutex_lock(os_mutex_t mutex) { (void) mutex; return 0; }
+inline int os_mutex_unlock(os_mutex_t mutex) { (void) mutex; return 0; }
+
+typedef void* os_semaphore_t;
+
+#define CONCURRENT_WAIT_FOREVER ((system_tick_t) -1)
+
+/**
+ * @brief Counting semaphore
+ *
+ * Provided by the platform file.  Without threads a take in hostPlatform.cpp
+ * fails rather than waits, simPlatform.cpp parks the calling thread until
+ * another gives.
+ *
+ * @return int 0 if successful, otherwise nonzero
+ */
+int os_semaphore_create(os_semaphore_t* semaphore, unsigned max_count, unsigned initial_count);
+int os_semaphore_take(os_semaphore_t semaphore, system_tick_t timeout, bool reserved);
+int os_semaphore_give(os_semaphore_t semaphore, bool reserved);
+
+/*
+ * Logging
+ */
+typedef enum LogLevel_
+{
+    LOG_LEVEL_TRACE = 1,
+    LOG_LEVEL_INFO = 30,
+    LOG_LEVEL_WARN = 40,
+    LOG_LEVEL_ERROR = 50,
+}LogLevel;
+
+inline void log_printf_v(int level, const char* category, void* reserved, const char* fmt, va_list args)
+{
+    (void) level; (void) category; (void) reserved; (void) fmt; (void) args;
+}
+
+/**
+ * @brief Logger, host builds discard log messages
+ *
+ */
+class Logger
+{
+    public:
+    explicit Logger(const char* name = NULL) { (void) name; }
+    void trace(const char* fmt, ...) const { (void) fmt; }
+    void info(const char* fmt, ...) const { (void) fmt; }
+    void warn(const char* fmt, ...) const { (void) fmt; }
+    void error(const char* fmt, ...) const { (void) fmt; }
+    bool isTraceEnabled(void) const { return false; }
+    bool isInfoEnabled(void) const { return false; }
+};
+static Logger Log;
+
+/*
+ * Streams and peripherals
+ */
+class Print
+{
+    public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size)
+    {
+        size_t i;
+        for(i = 0; i < size; i++)
+        {
+            this->write(buffer[i]);
+        }
+        return size;
+    }
+};
+
+class Stream : public Print
+{
+    public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() = 0;
+    virtual size_t readBytes(char* buffer, size_t length)
+    {
+        size_t i;
+        int c;
+        for(i = 0; i < length && (c = this->read()) >= 0; i++)
+        {
+            buffer[i] = (char) c;
+        }
+        return i;
+    }
+};
+
+/**
+ * @brief UART, host builds neither send nor receive
+ *
+ * GPS data is fed to the firmware through GPS_getch instead.
+ */
+class USARTSerial : public Stream
+{
+    public:
+    void begin(unsigned long baud) { (void) baud; }
+    void end(void) {}
+    int available() { return 0; }
+    int read() { return -1; }
+    int peek() { return -1; }
+    void flush() {}
+    size_t write(uint8_t c) { (void) c; return 1; }
+    using Print::write;
+    int printf(const char* fmt, ...) { (void) fmt; return 0; }
+};
+static USARTSerial Serial5;
+
+#define MSBFIRST    1
+#define SPI_MODE3   3
+class SPIClass {};
+
+class EEPROMClass
+{
+    public:
+    template <typename T> T& get(int addr, T& t)
+    {
+        memcpy(&t, this->data + addr, sizeof(T));
+        return t;
+    }
+    template <typename T> const T& put(int addr, const T& t)
+    {
+        memcpy(this->data + addr, &t, sizeof(T));
+        return t;
+    }
+    private:
+    uint8_t data[4096];
+};
+extern EEPROMClass EEPROM;
+
+class PMIC {};
+
+class FuelGauge
+{
+    public:
+    float getVCell(void);
+};
+
+class TimeClass
+{
+    public:
+    bool isValid(void) { return false; }
+};
+
+/*
+ * RGB LED
+ */
+#define RGB_COLOR_BLUE      0x000000ff
+#define RGB_COLOR_GREEN     0x0000ff00
+#define RGB_COLOR_RED       0x00ff0000
+#define RGB_COLOR_ORANGE    0x00ff6000
+#define RGB_COLOR_WHITE     0x00ffffff
+
+typedef enum LEDPattern_
+{
+    LED_PATTERN_SOLID,
+    LED_PATTERN_BLINK,
+    LED_PATTERN_FADE,
+}LEDPattern;
+
+typedef enum LEDPriority_
+{
+    LED_PRIORITY_BACKGROUND,
+    LED_PRIORITY_NORMAL,
+    LED_PRIORITY_IMPORTANT,
+    LED_PRIORITY_CRITICAL,
+}LEDPriority;
+
+class LEDStatus
+{
+    public:
+    void setColor(uint32_t color) { (void) color; }
+    void setPattern(LEDPattern pattern) { (void) pattern; }
+    void setPeriod(uint16_t period) { (void) period; }
+    void setPriority(LEDPriority priority) { (void) priority; }
+    void setActive(bool active = true) { (void) active; }
+};
+
+class LEDSystemTheme {};
+
+#endif
@@ -0,0 +1,186 @@
+#include "ramFlash.hpp"
+
+/**
+ * @brief Command and 3 byte address sent ahead of each operation
+ * 
+ */
+#define RAM_FLASH_COMMAND_LEN   4
+
+/**
+ * @brief Time SpiFlash waits after entering deep power down, in us
+ * 
+ */
+#define RAM_FLASH_DEEP_POWER_DOWN_US    10
+
+/**
+ * @brief Time SpiFlash waits after releasing deep power down, in us
+ * 
+ */
+#define RAM_FLASH_RELEASE_US    3
+
+RamFlash::RamFlash(size_t size) : data(size, 0xFF), timing(RAM_FLASH_TIMING_MX25L6406E), 
+    clock(NULL), pending_ns(0), poweredDown(false)
+{
+    this->resetStats();
+}
+
+void RamFlash::begin()
+{
+}
+
+bool RamFlash::isValid()
+{
+    return true;
+}
+
+uint32_t RamFlash::jedecIdRead()
+{
+    // Macronix MX25L6406
+    return 0xC22017;
+}
+
+void RamFlash::readData(size_t addr, void *buf, size_t bufLen)
+{
+    if(this->isIgnored() || addr + bufLen > this->data.size())
+    {
+        memset(buf, 0xFF, bufLen);
+        return;
+    }
+    memcpy(buf, &this->data[addr], bufLen);
+    this->stats.readOps++;
+    this->stats.bytesRead += bufLen;
+    this->charge(this->getTransfer_ns(bufLen));
+}
+
+void RamFlash::writeData(size_t addr, const void *buf, size_t bufLen)
+{
+    const uint8_t* pSrc = (const uint8_t*) buf;
+    size_t i;
+    size_t count;
+    uint64_t time_ns = 0;
+
+    if(this->isIgnored() || bufLen == 0 || addr + bufLen > this->data.size())
+    {
+        return;
+    }
+    for(i = 0; i < bufLen; i++)
+    {
+        this->data[addr + i] &= pSrc[i];
+    }
+    this->stats.writeOps++;
+    this->stats.bytesWritten += bufLen;
+    // SpiFlash programs each page separately and waits for it
+    for(i = 0; i < bufLen; i += count)
+    {
+        count = this->pageSize - (addr + i) % this->pageSize;
+        count = count < bufLen - i ? count : bufLen - i;
+        time_ns += this->getTransfer_ns(count) + this->timing.programSetup_us * 1000ULL + 
+            (count - 1) * (uint64_t) this->timing.programPerByte_ns;
+        this->stats.pagePrograms++;
+    }
+    this->charge(time_ns);
+}
+
+void RamFlash::sectorErase(size_t addr)
+{
+    addr -= addr % this->sectorSize;
+    if(this->isIgnored() || addr + this->sectorSize > this->data.size())
+    {
+        return;
+    }
+    memset(&this->data[addr], 0xFF, this->sectorSize);
+    this->stats.sectorErases++;
+    this->charge(this->getTransfer_ns(0) + this->timing.sectorErase_us * 1000ULL);
+}
+
+void RamFlash::chipErase()
+{
+    memset(&this->data[0], 0xFF, this->data.size());
+}
+
+void RamFlash::deepPowerDown()
+{
+    this->poweredDown = true;
+    this->stats.deepPowerDowns++;
+    this->charge(this->getCommand_ns() + RAM_FLASH_DEEP_POWER_DOWN_US * 1000ULL);
+}
+
+void RamFlash::wakeFromSleep()
+{
+    this->poweredDown = false;
+    this->charge(this->getCommand_ns() + RAM_FLASH_RELEASE_US * 1000ULL);
+}
+
+void RamFlash::setTiming(const RamFlashTiming_t& timing, RamFlash_ClockFn clock)
+{
+    this->timing = timing;
+    this->clock = clock;
+    this->pending_ns = 0;
+}
+
+void RamFlash::resetStats(void)
+{
+    memset(&this->stats, 0, sizeof(this->stats));
+}
+
+/**
+ * @brief Counts the time of an operation and charges it to the clock
+ * 
+ * @param ns Time in nanoseconds
+ */
+void RamFlash::charge(uint64_t ns)
+{
+    uint32_t op_us = (uint32_t) ((ns + 999) / 1000);
+
+    this->stats.busy_ns += ns;
+    if(op_us > this->stats.maxOp_us)
+    {
+        this->stats.maxOp_us = op_us;
+    }
+    if(this->clock)
+    {
+        this->pending_ns += ns;
+        if(this->pending_ns >= 1000)
+        {
+            this->clock(this->pending_ns / 1000);
+            this->pending_ns %= 1000;
+        }
+    }
+}
+
+/**
+ * @brief Returns the time to clock a command and data over SPI
+ * 
+ * @param nBytes Bytes of data after the command
+ * @return uint64_t Time in nanoseconds
+ */
+uint64_t RamFlash::getTransfer_ns(size_t nBytes) const
+{
+    return (RAM_FLASH_COMMAND_LEN + nBytes) * 8ULL * 1000 / this->timing.spiClock_MHz;
+}
+
+/**
+ * @brief Returns the time to clock a command without an address over SPI
+ * 
+ * @return uint64_t Time in nanoseconds
+ */
+uint64_t RamFlash::getCommand_ns(void) const
+{
+    return 8ULL * 1000 / this->timing.spiClock_MHz;
+}
+
+/**
+ * @brief Counts an operation issued in deep power down, which the flash
+ * ignores
+ * 
+ * @return int 1 if the flash is powered down, otherwise 0
+ */
+int RamFlash::isIgnored(void)
+{
+    if(!this->poweredDown)
+    {
+        return 0;
+    }
+    this->stats.ignoredOps++;
+    return 1;
+}
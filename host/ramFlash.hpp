@@ -0,0 +1,144 @@
+#ifndef __RAM_FLASH_HPP__
+#define __RAM_FLASH_HPP__
+/**
+ * @brief RAM-backed SPI flash for host builds
+ * 
+ * Behaves like NOR flash: programming can only clear bits, erasing a sector
+ * sets it to 0xFF, and in deep power down everything but the wake up is
+ * ignored.  Counts the operations issued by the file system, and models how
+ * long each would take on the Smartfin flash, split into pages and busy waits
+ * the way SpiFlash issues them.
+ */
+#include "SpiFlashRK.h"
+
+#include <vector>
+
+/**
+ * @brief Flash timing, typical values
+ * 
+ */
+typedef struct RamFlashTiming_
+{
+    /**
+     * @brief SPI clock in MHz
+     * 
+     */
+    uint32_t spiClock_MHz;
+    /**
+     * @brief Time to program the first byte of a page program in us
+     * 
+     */
+    uint32_t programSetup_us;
+    /**
+     * @brief Time to program each further byte in ns
+     * 
+     */
+    uint32_t programPerByte_ns;
+    /**
+     * @brief Time to erase a sector in us
+     * 
+     */
+    uint32_t sectorErase_us;
+}RamFlashTiming_t;
+
+/**
+ * @brief Macronix MX25L6406E at the SpiFlash default 30 MHz clock
+ * 
+ * 9 us byte program, 1.4 ms page program and 60 ms sector erase, typical.
+ */
+#define RAM_FLASH_TIMING_MX25L6406E {30, 9, 5400, 60000}
+
+typedef struct RamFlashStats_
+{
+    uint32_t readOps;
+    uint64_t bytesRead;
+    uint32_t writeOps;
+    uint64_t bytesWritten;
+    /**
+     * @brief Number of page programs, a write crossing a page boundary counts
+     * once per page
+     * 
+     */
+    uint32_t pagePrograms;
+    uint32_t sectorErases;
+    /**
+     * @brief Modelled time of all operations in ns
+     * 
+     */
+    uint64_t busy_ns;
+    /**
+     * @brief Modelled time of the longest operation in us
+     * 
+     */
+    uint32_t maxOp_us;
+    uint32_t deepPowerDowns;
+    /**
+     * @brief Reads, writes and erases issued in deep power down, which the
+     * flash ignores.  Reads return 0xFF
+     * 
+     */
+    uint32_t ignoredOps;
+}RamFlashStats_t;
+
+/**
+ * @brief Called with the modelled time of each operation
+ * 
+ * @param us Time in microseconds
+ */
+typedef void (*RamFlash_ClockFn)(uint64_t us);
+
+class RamFlash : public SpiFlashBase
+{
+    public:
+    /**
+     * @brief Creates a flash of the specified size, fully erased
+     * 
+     * Uses RAM_FLASH_TIMING_MX25L6406E and charges the time to no clock.
+     * 
+     * @param size Size in bytes, must be a multiple of the sector size
+     */
+    RamFlash(size_t size);
+    virtual ~RamFlash() {};
+
+    void begin();
+    bool isValid();
+    uint32_t jedecIdRead();
+    void readData(size_t addr, void *buf, size_t bufLen);
+    void writeData(size_t addr, const void *buf, size_t bufLen);
+    void sectorErase(size_t addr);
+    void chipErase();
+    void deepPowerDown();
+    void wakeFromSleep();
+
+    /**
+     * @brief Sets the timing model and the clock the modelled time is
+     * charged to
+     * 
+     * @param timing Flash timing
+     * @param clock Clock to advance, NULL to only count the time in the stats
+     */
+    void setTiming(const RamFlashTiming_t& timing, RamFlash_ClockFn clock);
+
+    size_t getSize(void) const { return this->data.size(); }
+    const RamFlashStats_t& getStats(void) const { return this->stats; }
+    void resetStats(void);
+
+    private:
+    void charge(uint64_t ns);
+    uint64_t getTransfer_ns(size_t nBytes) const;
+    uint64_t getCommand_ns(void) const;
+    int isIgnored(void);
+
+    std::vector<uint8_t> data;
+    RamFlashStats_t stats;
+    RamFlashTiming_t timing;
+    RamFlash_ClockFn clock;
+    /**
+     * @brief Modelled time not yet charged to the clock, below 1 us
+     * 
+     */
+    uint64_t pending_ns;
+    bool poweredDown;
+};
+
+#endif
@@ -0,0 +1,553 @@
+/**
+ * @brief Deterministic simulation of a surf session
+ * 
+ * Runs the firmware ride tasks, scheduler, recorder and SPIFFS against
+ * synthetic sensors on a virtual clock, so that hours of deployment run in
+ * seconds.  Reports the schedule statistics and the flash consumption.
+ */
+#include "Particle.h"
+#include "simPlatform.hpp"
+#include "ramFlash.hpp"
+
+#include "AK09916.h"
+#include "ICM20648.h"
+#include "max31725_cpp.h"
+#include "product.hpp"
+#include "recorder.hpp"
+#include "ride.hpp"
+#include "scheduler.hpp"
+#include "sleepTask.hpp"
+#include "system.hpp"
+#include "tmpSensor.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * @brief Size of the simulated flash, matches the Smartfin flash
+ * 
+ */
+#define SIM_FLASH_SIZE  (8 * 1024 * 1024)
+
+/**
+ * @brief Time charged for each I2C sensor read, in microseconds
+ * 
+ * 6 or 7 bytes at 400 kHz plus addressing.
+ */
+#define SIM_I2C_READ_US 250
+
+/**
+ * @brief Time the simulated surfer spends on the beach before getting wet, in ms
+ * 
+ */
+#define SIM_WET_DELAY_MS    10000
+
+/**
+ * @brief Bytes written to each old file in turn when aging the file system
+ * 
+ */
+#define SIM_AGE_CHUNK_LEN   1024
+
+/*
+ * Firmware objects normally set up by system.cpp
+ */
+static const RamFlashTiming_t SIM_flashTiming = RAM_FLASH_TIMING_MX25L6406E;
+static RamFlash SIM_flash(SIM_FLASH_SIZE);
+static SpiFlashPowerManager SIM_flashPower(SIM_flash);
+static SpiFlashPageBuffer SIM_pageBuffer(SIM_flashPower);
+static SpiffsParticle SIM_fs(SIM_pageBuffer);
+static FuelGauge SIM_battery;
+static WaterSensor SIM_waterSensor(WATER_DETECT_EN_PIN, WATER_DETECT_PIN, 
+    WATER_DETECT_SURF_SESSION_INIT_WINDOW, WATER_DETECT_ARRAY_SIZE);
+static Recorder SIM_recorder;
+static TinyGPSPlus SIM_gps;
+static ICM20648 SIM_imu(SF_ICM20648_ADDR);
+static I2C SIM_i2cBus;
+static MAX31725 SIM_max31725(SIM_i2cBus, 0);
+static tmpSensor SIM_tempSensor(SIM_max31725);
+static AK09916 SIM_mag(SF_AK09916_ADDR);
+static TimeClass SIM_time;
+
+static void SIM_waterTask(void);
+static Timer SIM_waterTimer(SYS_WATER_REFRESH_MS, SIM_waterTask, false);
+static void SIM_flashPowerTask(void);
+static Timer SIM_flashPowerTimer(SYS_FLASH_POWER_CHECK_MS, SIM_flashPowerTask, false);
+
+SystemDesc_t systemDesc, *pSystemDesc = &systemDesc;
+static SystemFlags_t SIM_systemFlags;
+
+static uint32_t SIM_seed = 1;
+
+static void SIM_waterTask(void)
+{
+    systemDesc.pWaterSensor->update();
+}
+
+static void SIM_flashPowerTask(void)
+{
+    SIM_flashPower.process();
+}
+
+/**
+ * @brief Returns repeatable noise in [-1, 1]
+ * 
+ * @return float Noise sample
+ */
+static float SIM_noise(void)
+{
+    // xorshift32
+    SIM_seed ^= SIM_seed << 13;
+    SIM_seed ^= SIM_seed >> 17;
+    SIM_seed ^= SIM_seed << 5;
+    return (SIM_seed / 2147483648.0f) - 1.0f;
+}
+
+/**
+ * @brief Returns the time in seconds used for the synthetic sensor streams
+ * 
+ * @return float Virtual time
+ */
+static float SIM_seconds(void)
+{
+    return SIM_now() / 1e6f;
+}
+
+/*
+ * Synthetic sensors.  These replace the drivers, and charge the time of the
+ * bus transfers to the virtual clock.
+ */
+MAX31725::MAX31725(I2C &i2c_bus, uint8_t slave_address) : m_i2c(i2c_bus), 
+    m_write_address(slave_address), m_read_address(slave_address | 1)
+{
+}
+
+MAX31725::~MAX31725()
+{
+}
+
+tmpSensor::tmpSensor(MAX31725 &sensor) : m_sensor(sensor)
+{
+}
+
+bool tmpSensor::init()
+{
+    SIM_advance(SIM_I2C_READ_US);
+    return true;
+}
+
+bool tmpSensor::stop()
+{
+    SIM_advance(SIM_I2C_READ_US);
+    return true;
+}
+
+float tmpSensor::getTemp()
+{
+    SIM_advance(SIM_I2C_READ_US);
+    // water cooling slowly over the session
+    return 18.0f - SIM_seconds() / 7200.0f + 0.05f * SIM_noise();
+}
+
+ICM20648::ICM20648(uint8_t address) : m_address(address)
+{
+}
+
+ICM20648::~ICM20648(void)
+{
+}
+
+bool ICM20648::open()
+{
+    delay(100);
+    return true;
+}
+
+void ICM20648::close(void)
+{
+}
+
+bool ICM20648::get_accelerometer(float *acc_x, float *acc_y, float *acc_z)
+{
+    float t = SIM_seconds();
+
+    SIM_advance(SIM_I2C_READ_US);
+    // 8 s swell
+    *acc_x = 0.1f * sinf(2 * M_PI * t / 8.0f) + 0.02f * SIM_noise();
+    *acc_y = 0.05f * cosf(2 * M_PI * t / 8.0f) + 0.02f * SIM_noise();
+    *acc_z = 1.0f + 0.3f * sinf(2 * M_PI * t / 8.0f) + 0.02f * SIM_noise();
+    this->m_accelRawData[0] = (uint8_t) (*acc_x * 100);
+    this->m_accelRawData[2] = (uint8_t) (*acc_y * 100);
+    this->m_accelRawData[4] = (uint8_t) (*acc_z * 100);
+    return true;
+}
+
+bool ICM20648::get_gyroscope(float *gyr_x, float *gyr_y, float *gyr_z)
+{
+    float t = SIM_seconds();
+
+    SIM_advance(SIM_I2C_READ_US);
+    *gyr_x = 5.0f * cosf(2 * M_PI * t / 8.0f) + SIM_noise();
+    *gyr_y = 3.0f * sinf(2 * M_PI * t / 8.0f) + SIM_noise();
+    *gyr_z = SIM_noise();
+    this->m_gyroRawData[0] = (uint8_t) *gyr_x;
+    this->m_gyroRawData[2] = (uint8_t) *gyr_y;
+    this->m_gyroRawData[4] = (uint8_t) *gyr_z;
+    return true;
+}
+
+void ICM20648::get_accel_raw_data(uint8_t *data)
+{
+    memcpy(data, this->m_accelRawData, sizeof(this->m_accelRawData));
+}
+
+void ICM20648::get_gyro_raw_data(uint8_t *data)
+{
+    memcpy(data, this->m_gyroRawData, sizeof(this->m_gyroRawData));
+}
+
+AK09916::AK09916(uint8_t address) : m_address(address)
+{
+}
+
+bool AK09916::open(void)
+{
+    delay(100);
+    return true;
+}
+
+void AK09916::close(void)
+{
+}
+
+bool AK09916::read(int16_t* x, int16_t* y, int16_t* z)
+{
+    SIM_advance(SIM_I2C_READ_US);
+    *x = (int16_t) (200 + 10 * SIM_noise());
+    *y = (int16_t) (-50 + 10 * SIM_noise());
+    *z = (int16_t) (400 + 10 * SIM_noise());
+    return true;
+}
+
+bool AK09916::read(uint8_t* data)
+{
+    SIM_advance(SIM_I2C_READ_US);
+    memset(data, 0, 6);
+    return true;
+}
+
+void SleepTask::setBootBehavior(BOOT_BEHAVIOR_e behavior)
+{
+    (void) behavior;
+}
+
+/**
+ * @brief Mirrors SYS_initSys for the parts the ride tasks use
+ * 
+ * @return int 1 if successful, otherwise 0
+ */
+static int SIM_initSys(void)
+{
+    memset(pSystemDesc, 0, sizeof(SystemDesc_t));
+    systemDesc.flags = &SIM_systemFlags;
+
+    // same layout as SYS_initFS
+    SIM_flashPower.withIdleTimeMs(SF_FLASH_POWER_DOWN_IDLE_MS);
+    SIM_pageBuffer.begin();
+    SIM_flash.setTiming(SIM_flashTiming, &SIM_advance);
+    SIM_fs.withPhysicalAddr(SF_FLASH_SIZE_MB * 1024 * 1024);
+    if(SIM_fs.mountAndFormatIfNecessary() != SPIFFS_OK)
+    {
+        printf("Failed to mount file system\n");
+        return 0;
+    }
+    systemDesc.pFileSystem = &SIM_fs;
+    systemDesc.pFlashPower = &SIM_flashPower;
+    SIM_flashPowerTimer.start();
+    systemDesc.pNvram = &NVRAM::getInstance();
+    SIM_recorder.init();
+    systemDesc.pRecorder = &SIM_recorder;
+
+    systemDesc.pBattery = &SIM_battery;
+    systemDesc.pWaterSensor = &SIM_waterSensor;
+    systemDesc.pWaterCheck = &SIM_waterTimer;
+    SIM_waterTimer.start();
+
+    systemDesc.pGPS = &SIM_gps;
+    systemDesc.pIMU = &SIM_imu;
+    systemDesc.pTempSensor = &SIM_tempSensor;
+    systemDesc.pCompass = &SIM_mag;
+    systemDesc.pTime = &SIM_time;
+    return 1;
+}
+
+/**
+ * @brief Fills the file system with two old files and deletes one
+ * 
+ * Leaves blocks that are part live and part deleted pages, as on a unit that
+ * has recorded and uploaded many sessions, so SPIFFS has to garbage collect
+ * to find erased pages.
+ * 
+ * @param percent Percentage of the file system to fill before deleting
+ * @return int 1 if successful, otherwise 0
+ */
+static int SIM_ageFileSystem(uint32_t percent)
+{
+    SpiffsParticleFile files[2];
+    uint8_t buffer[SIM_AGE_CHUNK_LEN];
+    uint32_t total, used;
+    uint32_t i;
+
+    files[0] = SIM_fs.openFile(".aged", SPIFFS_O_CREAT | SPIFFS_O_TRUNC | SPIFFS_O_RDWR);
+    files[1] = SIM_fs.openFile(".deleted", SPIFFS_O_CREAT | SPIFFS_O_TRUNC | SPIFFS_O_RDWR);
+    if(!files[0].isValid() || !files[1].isValid())
+    {
+        return 0;
+    }
+    memset(buffer, 0xA5, sizeof(buffer));
+    SIM_fs.info(&total, &used);
+    for(i = 0; used < (uint64_t) total * percent / 100; i++)
+    {
+        if(files[i % 2].write(buffer, sizeof(buffer)) != sizeof(buffer))
+        {
+            break;
+        }
+        SIM_fs.info(&total, &used);
+    }
+    files[0].close();
+    files[1].remove();
+    files[1].close();
+    return 1;
+}
+
+/**
+ * @brief Copies a file from the simulated file system to the host
+ * 
+ * @param pName File name
+ * @param pPath Host path
+ * @return int 1 if successful, otherwise 0
+ */
+static int SIM_saveFile(const char* pName, const char* pPath)
+{
+    SpiffsParticleFile file;
+    uint8_t buffer[256];
+    size_t nBytes;
+    FILE* pOut;
+
+    file = SIM_fs.openFile(pName, SPIFFS_O_RDONLY);
+    pOut = fopen(pPath, "wb");
+    if(!file.isValid() || !pOut)
+    {
+        file.close();
+        if(pOut)
+        {
+            fclose(pOut);
+        }
+        return 0;
+    }
+    while((nBytes = file.readBytes((char*) buffer, sizeof(buffer))) > 0)
+    {
+        fwrite(buffer, 1, nBytes, pOut);
+    }
+    file.close();
+    fclose(pOut);
+    return 1;
+}
+
+static void SIM_printUsage(const char* name)
+{
+    printf("Usage: %s [-d minutes] [-g gps_fix_s] [-s seed] [-a percent] [-c] [-o file] [-v]\n", name);
+    printf("  -d  Time in the water, default 120 minutes\n");
+    printf("  -g  Time to GPS fix after boot, default 60 s\n");
+    printf("  -s  Seed for the synthetic sensors, default 1\n");
+    printf("  -a  Fill the file system this full with old files and delete half\n");
+    printf("      of them before the ride, default 0\n");
+    printf("  -c  Erase ahead before the ride, as the charge state does\n");
+    printf("  -o  Save the session file to file\n");
+    printf("  -v  Print firmware console output\n");
+}
+
+int main(int argc, char** argv)
+{
+    RideInitTask rideInitTask;
+    RideTask rideTask;
+    uint32_t durationMin = 120;
+    uint32_t gpsFixTime_s = 60;
+    uint32_t agePercent = 0;
+    uint32_t openErases;
+    uint32_t eraseAheadSteps = 0;
+    int charge = 0;
+    uint32_t total, usedBefore, usedAfter;
+    system_tick_t rideStart, rideEnd;
+    uint64_t sessionBytes = 0;
+    float rideMinutes;
+    spiffs_DIR dir;
+    spiffs_dirent dirEntry;
+    const RamFlashStats_t& flashStats = SIM_flash.getStats();
+    const SpiFlashPageBufferStats& writeStats = SIM_pageBuffer.getStats();
+    SpiFlashPowerStats powerStats;
+    float savedCurrent_uA;
+    REC_StorageForecast_t estimate, forecast;
+    int hasEstimate, hasForecast;
+    const char* pSessionPath = NULL;
+    int opt;
+
+    while((opt = getopt(argc, argv, "d:g:s:a:co:vh")) != -1)
+    {
+        switch(opt)
+        {
+        case 'd':
+            durationMin = strtoul(optarg, NULL, 0);
+            break;
+        case 'g':
+            gpsFixTime_s = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            SIM_seed = strtoul(optarg, NULL, 0);
+            if(!SIM_seed)
+            {
+                SIM_seed = 1;
+            }
+            break;
+        case 'a':
+            agePercent = strtoul(optarg, NULL, 0);
+            break;
+        case 'c':
+            charge = 1;
+            break;
+        case 'o':
+            pSessionPath = optarg;
+            break;
+        case 'v':
+            SIM_setConsoleMode(SIM_CONSOLE_TIMESTAMPED);
+            break;
+        default:
+            SIM_printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    SIM_setGPSFixTime(gpsFixTime_s * 1000);
+    SIM_setPinInput(WATER_DETECT_PIN, 0, 0);
+    SIM_setPinInput(WATER_DETECT_PIN, 1, SIM_WET_DELAY_MS);
+    SIM_setPinInput(WATER_DETECT_PIN, 0, SIM_WET_DELAY_MS + durationMin * 60 * 1000);
+
+    if(!SIM_initSys())
+    {
+        return 1;
+    }
+    if(agePercent && !SIM_ageFileSystem(agePercent))
+    {
+        printf("Failed to age file system\n");
+        return 1;
+    }
+    SIM_flash.resetStats();
+    while(charge && SIM_recorder.eraseAhead(RIDE_getExpectedLength()))
+    {
+        eraseAheadSteps++;
+    }
+    if(charge)
+    {
+        printf("Erase ahead: %u steps, %u sector erases\n", eraseAheadSteps, flashStats.sectorErases);
+    }
+    SIM_fs.info(&total, &usedBefore);
+    // as the CLI shows it before the ride
+    hasEstimate = RIDE_getStorageForecast(&estimate);
+
+    rideInitTask.init();
+    if(rideInitTask.run() != STATE_DEPLOYED)
+    {
+        printf("Ride init did not detect water\n");
+        return 1;
+    }
+    rideInitTask.exit();
+
+    SIM_flash.resetStats();
+    SIM_pageBuffer.resetStats();
+    SIM_flashPower.resetStats();
+    rideStart = millis();
+    rideTask.init();
+    openErases = flashStats.sectorErases;
+    rideTask.run();
+    // forecast as the last ensemble 12 would, while the session is still open
+    hasForecast = RIDE_getStorageForecast(&forecast);
+    rideTask.exit();
+    rideEnd = millis();
+    powerStats = SIM_flashPower.getStats();
+    savedCurrent_uA = SIM_flashPower.getSavedCurrent_uA();
+    rideMinutes = (rideEnd - rideStart) / 60000.0f;
+
+    SIM_fs.info(&total, &usedAfter);
+    if(SIM_fs.opendir("", &dir))
+    {
+        while(SIM_fs.readdir(&dir, &dirEntry))
+        {
+            if(dirEntry.name[0] == '.')
+            {
+                // session index
+                continue;
+            }
+            printf("Session file %s: %u bytes\n", dirEntry.name, dirEntry.size);
+            sessionBytes += dirEntry.size;
+            if(pSessionPath && !SIM_saveFile((const char*) dirEntry.name, pSessionPath))
+            {
+                printf("Could not save %s to %s\n", dirEntry.name, pSessionPath);
+            }
+        }
+        SIM_fs.closedir(&dir);
+    }
+
+    printf("\nRide ran for %.1f virtual minutes\n\n", rideMinutes);
+    SIM_setConsoleMode(SIM_CONSOLE_PLAIN);
+    SCH_displayStats(deploymentSchedule);
+    SF_OSAL_printf("\n");
+    SCH_displayTiming(deploymentSchedule);
+    SCH_displayIdleStats();
+    SF_OSAL_printf("\nRecorder\n");
+    SIM_recorder.displayQueueStats();
+
+    printf("\nData\n");
+    printf("  Session bytes:    %llu\n", (unsigned long long) sessionBytes);
+    printf("  Packets:          %llu\n", (unsigned long long) (sessionBytes / REC_MAX_PACKET_SIZE));
+    printf("  Bytes/min:        %.1f\n", sessionBytes / rideMinutes);
+    printf("  Packets/min:      %.2f\n", sessionBytes / REC_MAX_PACKET_SIZE / rideMinutes);
+    printf("\nFile system (%u bytes)\n", total);
+    printf("  Used before:      %u (%.1f%%)\n", usedBefore, 100.0 * usedBefore / total);
+    printf("  Used after:       %u (%.1f%%)\n", usedAfter, 100.0 * usedAfter / total);
+    if(usedAfter > usedBefore)
+    {
+        printf("  Hours until full: %.1f\n", 
+            (double)(total - usedAfter) / (usedAfter - usedBefore) * rideMinutes / 60);
+    }
+    if(hasEstimate)
+    {
+        printf("  Before the ride:  %.1f hours at %u bytes/min %s\n",
+            estimate.minutesRemaining / 60.0, estimate.bytesPerMinute,
+            estimate.measured ? "measured" : "from the schedule");
+    }
+    if(hasForecast)
+    {
+        printf("  Forecast:         %.1f hours at %u bytes/min %s, %u%% padding\n",
+            forecast.minutesRemaining / 60.0, forecast.bytesPerMinute,
+            forecast.measured ? "measured" : "from the schedule", forecast.paddingPercent);
+    }
+    printf("\nFlash\n");
+    printf("  Reads:            %u (%llu bytes)\n", flashStats.readOps, (unsigned long long) flashStats.bytesRead);
+    printf("  Writes:           %u (%u bytes)\n", writeStats.writeOps, writeStats.bytesWritten);
+    printf("  Page programs:    %u (%llu bytes)\n", flashStats.pagePrograms,
+        (unsigned long long) flashStats.bytesWritten);
+    printf("  Sector erases:    %u (%u while recording)\n", flashStats.sectorErases, 
+        flashStats.sectorErases - openErases);
+    printf("  Busy:             %.1f ms, longest operation %.1f ms\n", 
+        flashStats.busy_ns / 1e6, flashStats.maxOp_us / 1e3);
+    printf("  Power downs:      %u, %.1f%% of the ride, saving %.1f uAh per hour\n",
+        powerStats.powerDowns, 100.0 * powerStats.powerDownTime_ms / powerStats.elapsed_ms,
+        savedCurrent_uA);
+    printf("  Wakes:            %u, %u us total, longest %u us\n", powerStats.wakes,
+        powerStats.wakeTime_us, powerStats.maxWakeTime_us);
+    if(flashStats.ignoredOps)
+    {
+        printf("  %u operations issued in deep power down!\n", flashStats.ignoredOps);
+    }
+    return 0;
+}
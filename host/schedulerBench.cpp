@@ -0,0 +1,143 @@
+/**
+ * @brief Host-side benchmark of the deployment scheduler
+ *
+ * Compares dispatching a schedule with the linear table scan
+ * (SCH_getNextEvent) against the heap event queue (SCH_peekNextEvent and
+ * SCH_rescheduleEvent).  Time is virtual: each dispatch jumps straight to the
+ * next event time, so only scheduler overhead is measured.  Both dispatchers
+ * must produce the same event sequence.
+ *
+ * Build with SCH_MAX_SCHEDULE_LEN=256, see host/README.md.
+ */
+#include "scheduler.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define BENCH_N_DISPATCHES  200000
+#define BENCH_N_REPEATS     5
+
+static uint32_t BENCH_callCount;
+static uint32_t BENCH_checksum;
+
+static void BENCH_ensembleInit(DeploymentSchedule_t* pDeployment)
+{
+    (void) pDeployment;
+}
+
+static void BENCH_ensembleFunc(DeploymentSchedule_t* pDeployment)
+{
+    (void) pDeployment;
+    BENCH_callCount++;
+}
+
+/**
+ * @brief Builds a NULL terminated schedule of nEntries mixed rate ensembles
+ *
+ * Intervals are drawn from the rates a deployment would use (per-axis IMU,
+ * GPS, battery, diagnostics), and delays stagger the entries.
+ */
+static void BENCH_buildSchedule(std::vector<DeploymentSchedule_t>& schedule, size_t nEntries)
+{
+    static const uint32_t intervals[] = {20, 50, 100, 250, 1000, 5000, 10000, 60000};
+    size_t i;
+
+    schedule.assign(nEntries + 1, DeploymentSchedule_t());
+    for(i = 0; i < nEntries; i++)
+    {
+        schedule[i].func = &BENCH_ensembleFunc;
+        schedule[i].init = &BENCH_ensembleInit;
+        schedule[i].measurementsToAccumulate = 1;
+        schedule[i].ensembleDelay = (i * 7) % 50;
+        schedule[i].ensembleInterval = intervals[i % (sizeof(intervals) / sizeof(intervals[0]))];
+        schedule[i].nMeasurements = UINT32_MAX;
+    }
+}
+
+static double BENCH_runLinear(DeploymentSchedule_t* pSchedule, uint32_t* pChecksum)
+{
+    DeploymentSchedule_t* pNextEvent;
+    size_t nextEventTime;
+    uint32_t i;
+    std::chrono::steady_clock::time_point start, stop;
+
+    SCH_initializeSchedule(pSchedule, 1);
+    BENCH_checksum = 0;
+    start = std::chrono::steady_clock::now();
+    for(i = 0; i < BENCH_N_DISPATCHES; i++)
+    {
+        SCH_getNextEvent(pSchedule, &pNextEvent, &nextEventTime);
+        pNextEvent->func(pNextEvent);
+        pNextEvent->lastExecuteTime = nextEventTime;
+        pNextEvent->measurementCount++;
+        BENCH_checksum = BENCH_checksum * 31 + (uint32_t) (pNextEvent - pSchedule) + nextEventTime;
+    }
+    stop = std::chrono::steady_clock::now();
+    *pChecksum = BENCH_checksum;
+    return std::chrono::duration<double, std::nano>(stop - start).count() / BENCH_N_DISPATCHES;
+}
+
+static double BENCH_runHeap(DeploymentSchedule_t* pSchedule, uint32_t* pChecksum)
+{
+    static SCH_EventQueue_t queue;
+    DeploymentSchedule_t* pNextEvent;
+    size_t nextEventTime;
+    uint32_t i;
+    std::chrono::steady_clock::time_point start, stop;
+
+    SCH_initializeSchedule(pSchedule, 1);
+    SCH_initializeQueue(&queue, pSchedule);
+    BENCH_checksum = 0;
+    start = std::chrono::steady_clock::now();
+    for(i = 0; i < BENCH_N_DISPATCHES; i++)
+    {
+        SCH_peekNextEvent(&queue, &pNextEvent, &nextEventTime);
+        pNextEvent->func(pNextEvent);
+        SCH_rescheduleEvent(&queue, nextEventTime);
+        BENCH_checksum = BENCH_checksum * 31 + (uint32_t) (pNextEvent - pSchedule) + nextEventTime;
+    }
+    stop = std::chrono::steady_clock::now();
+    *pChecksum = BENCH_checksum;
+    return std::chrono::duration<double, std::nano>(stop - start).count() / BENCH_N_DISPATCHES;
+}
+
+int main(void)
+{
+    static const size_t sizes[] = {4, 32, 256};
+    std::vector<DeploymentSchedule_t> schedule;
+    uint32_t linearChecksum, heapChecksum;
+    double linearNs, heapNs, t;
+    size_t i;
+    int j;
+    int retval = 0;
+
+    if(SCH_MAX_SCHEDULE_LEN < 256)
+    {
+        printf("Build with -DSCH_MAX_SCHEDULE_LEN=256\n");
+        return 1;
+    }
+
+    printf("%8s\t%12s\t%12s\t%8s\n", "entries", "linear ns", "heap ns", "speedup");
+    for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        BENCH_buildSchedule(schedule, sizes[i]);
+        linearNs = heapNs = 1e300;
+        for(j = 0; j < BENCH_N_REPEATS; j++)
+        {
+            t = BENCH_runLinear(schedule.data(), &linearChecksum);
+            linearNs = t < linearNs ? t : linearNs;
+            t = BENCH_runHeap(schedule.data(), &heapChecksum);
+            heapNs = t < heapNs ? t : heapNs;
+        }
+        printf("%8zu\t%12.1f\t%12.1f\t%7.2fx\n", sizes[i], linearNs, heapNs, linearNs / heapNs);
+        if(linearChecksum != heapChecksum)
+        {
+            printf("Dispatch order mismatch at %zu entries!\n", sizes[i]);
+            retval = 1;
+        }
+    }
+    printf("%u ensemble calls\n", BENCH_callCount);
+    return retval;
+}
@@ -0,0 +1,188 @@
+/**
+ * @brief Decodes a session file
+ *
+ * Reference decoder for the packet format: checks each packet's CRC,
+ * decompresses and delta decodes its ensembles, and prints one line per
+ * record with the ensemble type, elapsed time and data bytes.  Every packet
+ * is decoded on its own, as the backend receives them, so records split
+ * across packets are reported but not printed.
+ */
+#include "ensembleCodec.hpp"
+#include "sessionFile.hpp"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * @brief Returns the length of an uncoded record
+ *
+ * @param pRecord Record
+ * @param nBytes Bytes left in the packet
+ * @return size_t Length of the record, 0 if unknown
+ */
+static size_t DEC_getRecordLen(const uint8_t* pRecord, size_t nBytes)
+{
+    EnsembleHeader_t header;
+
+    if(nBytes < sizeof(EnsembleHeader_t))
+    {
+        return 0;
+    }
+    memcpy(&header, pRecord, sizeof(EnsembleHeader_t));
+    switch(header.ensembleType)
+    {
+    case ENS_BATT:
+        return sizeof(EnsembleHeader_t) + sizeof(Ensemble07_data_t);
+    case ENS_TEMP_TIME:
+        return sizeof(EnsembleHeader_t) + sizeof(Ensemble08_data_t);
+    case ENS_TEMP_IMU:
+        return sizeof(EnsembleHeader_t) + sizeof(Ensemble10_data_t);
+    case ENS_TEMP_IMU_GPS:
+        return sizeof(EnsembleHeader_t) + sizeof(Ensemble11_data_t);
+    case ENS_STORAGE:
+        return sizeof(EnsembleHeader_t) + sizeof(Ensemble12_data_t);
+    case ENS_TEXT:
+        return nBytes > sizeof(EnsembleHeader_t) ?
+            sizeof(EnsembleHeader_t) + 1 + pRecord[sizeof(EnsembleHeader_t)] : 0;
+    default:
+        return 0;
+    }
+}
+
+static void DEC_printRecord(const uint8_t* pRecord, size_t nBytes)
+{
+    EnsembleHeader_t header;
+    size_t i;
+
+    memcpy(&header, pRecord, sizeof(EnsembleHeader_t));
+    printf("  %02X %7u ", header.ensembleType, header.elapsedTime_ds);
+    for(i = sizeof(EnsembleHeader_t); i < nBytes; i++)
+    {
+        printf("%02X", pRecord[i]);
+    }
+    printf("\n");
+}
+
+static void DEC_printUsage(const char* name)
+{
+    printf("Usage: %s [-q] session_file\n", name);
+    printf("  -q  Print the totals only\n");
+}
+
+int main(int argc, char** argv)
+{
+    static uint8_t packet[REC_MAX_PACKET_SIZE];
+    static uint8_t ensembles[PKT_MAX_ENSEMBLES_LEN];
+    uint8_t record[REC_MAX_PACKET_SIZE];
+    REC_PacketHeader_t header;
+    EnsembleCodec_t codec;
+    FILE* pFile;
+    int quiet = 0;
+    int opt;
+    int packetLen;
+    int nEnsembles;
+    int nDecoded;
+    size_t recordLen;
+    size_t idx;
+    uint32_t nPackets = 0, nCompressed = 0, nCorrupt = 0;
+    uint32_t nRecords = 0, nSplit = 0;
+    uint64_t storedBytes = 0, ensembleBytes = 0;
+
+    while((opt = getopt(argc, argv, "qh")) != -1)
+    {
+        switch(opt)
+        {
+        case 'q':
+            quiet = 1;
+            break;
+        default:
+            DEC_printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if(optind >= argc)
+    {
+        DEC_printUsage(argv[0]);
+        return 1;
+    }
+    pFile = fopen(argv[optind], "rb");
+    if(!pFile)
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    while((packetLen = PKT_read(pFile, packet)) != 0)
+    {
+        if(packetLen < 0)
+        {
+            printf("Packet at %ld is corrupt\n", ftell(pFile) - REC_MAX_PACKET_SIZE);
+            nCorrupt++;
+            continue;
+        }
+        PKT_getHeader(packet, &header);
+        nEnsembles = PKT_getEnsembles(packet, ensembles);
+        if(nEnsembles < 0)
+        {
+            printf("Packet %u does not decompress\n", header.sequence);
+            nCorrupt++;
+            continue;
+        }
+        nPackets++;
+        nCompressed += (header.flags & REC_PACKET_FLAG_COMPRESSED) ? 1 : 0;
+        storedBytes += packetLen;
+        ensembleBytes += nEnsembles;
+        if(!quiet)
+        {
+            printf("Packet %u, session %u, flags 0x%04X, %u bytes, %d bytes of ensembles\n",
+                header.sequence, header.sessionId, header.flags, header.nBytes, nEnsembles);
+        }
+
+        // a record continued from the previous packet cannot be decoded alone
+        idx = header.nContinued;
+        nSplit += header.nContinued ? 1 : 0;
+        Ens_resetCodec(&codec);
+        while(idx < (size_t) nEnsembles)
+        {
+            recordLen = sizeof(record);
+            if(header.flags & REC_PACKET_FLAG_DELTA)
+            {
+                nDecoded = Ens_decodeRecord(&codec, ensembles + idx, nEnsembles - idx,
+                    record, &recordLen);
+            }
+            else
+            {
+                recordLen = DEC_getRecordLen(ensembles + idx, nEnsembles - idx);
+                nDecoded = recordLen > 0 && recordLen <= nEnsembles - idx ? recordLen : 0;
+                memcpy(record, ensembles + idx, nDecoded);
+            }
+            if(nDecoded < 0)
+            {
+                printf("Packet %u has an invalid record at %zu\n", header.sequence, idx);
+                break;
+            }
+            if(nDecoded == 0)
+            {
+                // continues in the next packet, or padding
+                break;
+            }
+            if(!quiet)
+            {
+                DEC_printRecord(record, recordLen);
+            }
+            nRecords++;
+            idx += nDecoded;
+        }
+    }
+    fclose(pFile);
+
+    printf("Packets:            %u (%u compressed, %u corrupt)\n", nPackets, nCompressed, nCorrupt);
+    printf("Records:            %u (%u split)\n", nRecords, nSplit);
+    printf("Stored bytes:       %llu\n", (unsigned long long) storedBytes);
+    printf("Ensemble bytes:     %llu\n", (unsigned long long) ensembleBytes);
+    if(nPackets)
+    {
+        printf("Records per packet: %.1f\n", (double) nRecords / nPackets);
+    }
+    return nCorrupt ? 2 : 0;
+}
@@ -0,0 +1,60 @@
+#include "sessionFile.hpp"
+
+#include "crc32.hpp"
+#include "lzss.hpp"
+#include "utils.hpp"
+
+int PKT_read(FILE* pFile, uint8_t* pPacket)
+{
+    REC_PacketHeader_t header;
+    size_t nRead;
+    uint32_t crc;
+
+    nRead = fread(pPacket, 1, REC_MAX_PACKET_SIZE, pFile);
+    if(nRead == 0)
+    {
+        return 0;
+    }
+    if(nRead < sizeof(REC_PacketHeader_t))
+    {
+        return -1;
+    }
+    PKT_getHeader(pPacket, &header);
+    if(header.magic != REC_PACKET_MAGIC || header.nBytes > nRead - sizeof(REC_PacketHeader_t))
+    {
+        return -1;
+    }
+    crc = CRC32_update(CRC32_INIT, pPacket, offsetof(REC_PacketHeader_t, crc));
+    crc = CRC32_update(crc, pPacket + sizeof(REC_PacketHeader_t), header.nBytes);
+    if(crc != header.crc)
+    {
+        return -1;
+    }
+    return sizeof(REC_PacketHeader_t) + header.nBytes;
+}
+
+void PKT_getHeader(const uint8_t* pPacket, REC_PacketHeader_t* pHeader)
+{
+    memcpy(pHeader, pPacket, sizeof(REC_PacketHeader_t));
+    pHeader->magic = B_TO_N_ENDIAN_2(pHeader->magic);
+    pHeader->sequence = B_TO_N_ENDIAN_2(pHeader->sequence);
+    pHeader->sessionId = B_TO_N_ENDIAN_4(pHeader->sessionId);
+    pHeader->nBytes = B_TO_N_ENDIAN_2(pHeader->nBytes);
+    pHeader->nContinued = B_TO_N_ENDIAN_2(pHeader->nContinued);
+    pHeader->flags = B_TO_N_ENDIAN_2(pHeader->flags);
+    pHeader->crc = B_TO_N_ENDIAN_4(pHeader->crc);
+}
+
+int PKT_getEnsembles(const uint8_t* pPacket, uint8_t* pEnsembles)
+{
+    REC_PacketHeader_t header;
+
+    PKT_getHeader(pPacket, &header);
+    if(header.flags & REC_PACKET_FLAG_COMPRESSED)
+    {
+        return LZSS_decompress(pPacket + sizeof(REC_PacketHeader_t), header.nBytes,
+            pEnsembles, PKT_MAX_ENSEMBLES_LEN);
+    }
+    memcpy(pEnsembles, pPacket + sizeof(REC_PacketHeader_t), header.nBytes);
+    return header.nBytes;
+}
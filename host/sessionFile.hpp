@@ -0,0 +1,47 @@
+#ifndef __SESSION_FILE_HPP__
+#define __SESSION_FILE_HPP__
+/**
+ * @brief Reader for session files and uploaded packets
+ *
+ * Reverses what the recorder does to ensembles on the way to flash: checks
+ * the packet CRC and decompresses the ensembles.  Delta encoded ensembles are
+ * decoded with Ens_decodeRecord.
+ */
+#include "recorder.hpp"
+
+#include <stdio.h>
+
+/**
+ * @brief Largest number of bytes of ensembles in a packet
+ *
+ */
+#define PKT_MAX_ENSEMBLES_LEN   LZSS_MAX_INPUT_LEN
+
+/**
+ * @brief Reads the next packet of a session file
+ *
+ * @param pFile Session file, positioned at a packet
+ * @param pPacket Buffer of REC_MAX_PACKET_SIZE bytes
+ * @return int Length of the packet without padding, 0 at the end of the
+ * file, or -1 if the packet is corrupt or has no header
+ */
+int PKT_read(FILE* pFile, uint8_t* pPacket);
+
+/**
+ * @brief Returns the header of a packet, in host byte order
+ *
+ * @param pPacket Packet
+ * @param pHeader Header to fill
+ */
+void PKT_getHeader(const uint8_t* pPacket, REC_PacketHeader_t* pHeader);
+
+/**
+ * @brief Extracts the ensembles of a packet, decompressing them if needed
+ *
+ * @param pPacket Packet
+ * @param pEnsembles Buffer of PKT_MAX_ENSEMBLES_LEN bytes
+ * @return int Number of bytes of ensembles, or -1 if they do not decompress
+ */
+int PKT_getEnsembles(const uint8_t* pPacket, uint8_t* pEnsembles);
+
+#endif
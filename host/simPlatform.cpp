@@ -0,0 +1,510 @@
+#include "simPlatform.hpp"
+
+#include "conio.hpp"
+
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+#include <ucontext.h>
+#include <vector>
+
+typedef struct SIM_PinEvent_
+{
+    system_tick_t time;
+    uint8_t value;
+}SIM_PinEvent_t;
+
+static uint64_t SIM_time_us = 0;
+static uint8_t SIM_pins[HOST_NUM_PINS];
+static std::vector<SIM_PinEvent_t> SIM_pinEvents[HOST_NUM_PINS];
+static float SIM_batteryVoltage = 4.0;
+static system_tick_t SIM_gpsFixTime = 0;
+static system_tick_t SIM_gpsLastReport = 0;
+static bool SIM_gpsHasReported = false;
+static std::string SIM_gpsBuffer;
+static size_t SIM_gpsIdx = 0;
+static SIM_ConsoleMode_e SIM_consoleMode = SIM_CONSOLE_QUIET;
+static bool SIM_consoleLineStart = true;
+
+/**
+ * @brief Cooperative thread
+ * 
+ * Threads run on their own stack, switched to from the main thread when the
+ * virtual clock reaches their wake time, and switch back whenever they wait.
+ */
+typedef struct SIM_Thread_
+{
+    ucontext_t context;
+    std::vector<uint8_t> stack;
+    os_thread_fn_t fn;
+    void* pParam;
+    uint64_t wakeTime;
+}SIM_Thread_t;
+
+static std::vector<SIM_Thread_t*> SIM_threads;
+static SIM_Thread_t* SIM_pCurrentThread = NULL;
+static ucontext_t SIM_mainContext;
+
+/**
+ * @brief Counting semaphore
+ * 
+ * Threads that take it while the count is 0 park until a give, or until
+ * their timeout, and are run again by the main thread.
+ */
+typedef struct SIM_Semaphore_
+{
+    unsigned count;
+    unsigned maxCount;
+    std::vector<SIM_Thread_t*> waiters;
+}SIM_Semaphore_t;
+
+Timer* Timer::pFirst = NULL;
+SystemClass System;
+CloudClass Particle;
+EEPROMClass EEPROM;
+
+void Timer::process(system_tick_t now)
+{
+    static bool inProgress = false;
+    Timer* pTimer;
+
+    // timer callbacks may themselves wait
+    if(inProgress)
+    {
+        return;
+    }
+    inProgress = true;
+    for(pTimer = Timer::pFirst; pTimer; pTimer = pTimer->pNext)
+    {
+        while(pTimer->active && (int32_t)(now - pTimer->nextTime) >= 0)
+        {
+            if(pTimer->oneShot)
+            {
+                pTimer->active = false;
+            }
+            pTimer->nextTime += pTimer->period;
+            pTimer->callback();
+        }
+    }
+    inProgress = false;
+}
+
+/**
+ * @brief Returns the time in ms until the next active timer is due
+ * 
+ * @return uint64_t Time until the next timer, UINT64_MAX if none are active
+ */
+static uint64_t SIM_timeToNextTimer(void)
+{
+    Timer* pTimer;
+    uint64_t minTime = UINT64_MAX;
+    int32_t dt;
+
+    for(pTimer = Timer::pFirst; pTimer; pTimer = pTimer->pNext)
+    {
+        if(!pTimer->active)
+        {
+            continue;
+        }
+        dt = (int32_t)(pTimer->nextTime - millis());
+        if(dt < 0)
+        {
+            dt = 0;
+        }
+        if((uint64_t)dt < minTime)
+        {
+            minTime = dt;
+        }
+    }
+    return minTime;
+}
+
+/**
+ * @brief Returns the virtual time of the next timer or thread wakeup
+ * 
+ * @return uint64_t Time of the next event in us, UINT64_MAX if there is none
+ */
+static uint64_t SIM_nextEventTime(void)
+{
+    uint64_t eventTime = SIM_timeToNextTimer();
+    size_t i;
+
+    if(eventTime != UINT64_MAX)
+    {
+        eventTime = (millis() + eventTime) * 1000;
+    }
+    for(i = 0; i < SIM_threads.size(); i++)
+    {
+        if(SIM_threads[i]->wakeTime < eventTime)
+        {
+            eventTime = SIM_threads[i]->wakeTime;
+        }
+    }
+    return eventTime;
+}
+
+/**
+ * @brief Runs each thread whose wake time has come until it waits again
+ * 
+ */
+static void SIM_runThreads(void)
+{
+    size_t i;
+
+    for(i = 0; i < SIM_threads.size(); i++)
+    {
+        if(SIM_threads[i]->wakeTime > SIM_time_us)
+        {
+            continue;
+        }
+        SIM_pCurrentThread = SIM_threads[i];
+        swapcontext(&SIM_mainContext, &SIM_threads[i]->context);
+        SIM_pCurrentThread = NULL;
+    }
+}
+
+void SIM_advance(uint64_t us)
+{
+    uint64_t endTime = SIM_time_us + us;
+    uint64_t eventTime;
+
+    if(SIM_pCurrentThread)
+    {
+        // only the main thread moves the clock, threads wait for it
+        SIM_pCurrentThread->wakeTime = endTime;
+        swapcontext(&SIM_pCurrentThread->context, &SIM_mainContext);
+        return;
+    }
+
+    // step to each timer and thread wakeup in turn so that they run on time
+    while(1)
+    {
+        eventTime = SIM_nextEventTime();
+        if(eventTime > endTime)
+        {
+            break;
+        }
+        if(eventTime > SIM_time_us)
+        {
+            SIM_time_us = eventTime;
+        }
+        Timer::process(millis());
+        SIM_runThreads();
+        if(SIM_nextEventTime() <= SIM_time_us)
+        {
+            // a timer could not run (callback in progress), don't spin
+            break;
+        }
+    }
+    if(endTime > SIM_time_us)
+    {
+        SIM_time_us = endTime;
+    }
+    Timer::process(millis());
+    SIM_runThreads();
+}
+
+uint64_t SIM_now(void)
+{
+    return SIM_time_us;
+}
+
+system_tick_t millis(void)
+{
+    return (system_tick_t)(SIM_time_us / 1000);
+}
+
+unsigned long micros(void)
+{
+    return (unsigned long) SIM_time_us;
+}
+
+void delay(unsigned long ms)
+{
+    SIM_advance((uint64_t) ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    SIM_advance(us);
+}
+
+void os_thread_yield(void)
+{
+    SIM_advance(SIM_YIELD_US);
+}
+
+/**
+ * @brief Runs a thread function, and parks the thread if it returns
+ * 
+ * @param idx Index of the thread
+ */
+static void SIM_threadEntry(int idx)
+{
+    SIM_Thread_t* pThread = SIM_threads[idx];
+
+    pThread->fn(pThread->pParam);
+    pThread->wakeTime = UINT64_MAX;
+}
+
+int os_thread_create(os_thread_t* thread, const char* name, os_thread_prio_t priority,
+    os_thread_fn_t fun, void* thread_param, size_t stack_size)
+{
+    SIM_Thread_t* pThread = new SIM_Thread_t;
+
+    (void) name;
+    (void) priority;
+    // host stack frames are much larger than the device's
+    if(stack_size < SIM_THREAD_MIN_STACK_SIZE)
+    {
+        stack_size = SIM_THREAD_MIN_STACK_SIZE;
+    }
+    pThread->stack.resize(stack_size);
+    pThread->fn = fun;
+    pThread->pParam = thread_param;
+    pThread->wakeTime = SIM_time_us;
+    getcontext(&pThread->context);
+    pThread->context.uc_stack.ss_sp = pThread->stack.data();
+    pThread->context.uc_stack.ss_size = pThread->stack.size();
+    pThread->context.uc_link = &SIM_mainContext;
+    makecontext(&pThread->context, (void (*)(void)) SIM_threadEntry, 1, (int) SIM_threads.size());
+    SIM_threads.push_back(pThread);
+    if(thread)
+    {
+        *thread = pThread;
+    }
+    return 0;
+}
+
+int os_semaphore_create(os_semaphore_t* semaphore, unsigned max_count, unsigned initial_count)
+{
+    SIM_Semaphore_t* pSemaphore = new SIM_Semaphore_t;
+
+    pSemaphore->count = initial_count;
+    pSemaphore->maxCount = max_count;
+    *semaphore = pSemaphore;
+    return 0;
+}
+
+int os_semaphore_take(os_semaphore_t semaphore, system_tick_t timeout, bool reserved)
+{
+    SIM_Semaphore_t* pSemaphore = (SIM_Semaphore_t*) semaphore;
+    SIM_Thread_t* pThread = SIM_pCurrentThread;
+    uint64_t deadline = UINT64_MAX;
+    size_t i;
+
+    (void) reserved;
+    if(CONCURRENT_WAIT_FOREVER != timeout)
+    {
+        deadline = SIM_time_us + (uint64_t) timeout * 1000;
+    }
+    while(0 == pSemaphore->count)
+    {
+        if(SIM_time_us >= deadline)
+        {
+            return -1;
+        }
+        if(!pThread)
+        {
+            // the main thread moves the clock, so it polls
+            SIM_advance(SIM_YIELD_US);
+            continue;
+        }
+        pSemaphore->waiters.push_back(pThread);
+        pThread->wakeTime = deadline;
+        swapcontext(&pThread->context, &SIM_mainContext);
+        for(i = 0; i < pSemaphore->waiters.size(); i++)
+        {
+            if(pSemaphore->waiters[i] == pThread)
+            {
+                pSemaphore->waiters.erase(pSemaphore->waiters.begin() + i);
+                break;
+            }
+        }
+    }
+    pSemaphore->count--;
+    return 0;
+}
+
+int os_semaphore_give(os_semaphore_t semaphore, bool reserved)
+{
+    SIM_Semaphore_t* pSemaphore = (SIM_Semaphore_t*) semaphore;
+    size_t i;
+
+    (void) reserved;
+    if(pSemaphore->count >= pSemaphore->maxCount)
+    {
+        return -1;
+    }
+    pSemaphore->count++;
+    // run the waiters at the next event check
+    for(i = 0; i < pSemaphore->waiters.size(); i++)
+    {
+        pSemaphore->waiters[i]->wakeTime = SIM_time_us;
+    }
+    return 0;
+}
+
+void SystemClass::sleep(const SystemSleepConfiguration& config)
+{
+    SIM_advance((uint64_t) config.sleepDuration_ms * 1000 + SIM_SLEEP_WAKE_LATENCY_US);
+}
+
+void SIM_setPinInput(pin_t pin, uint8_t value, system_tick_t atTime)
+{
+    SIM_PinEvent_t event;
+
+    event.time = atTime;
+    event.value = value;
+    SIM_pinEvents[pin].push_back(event);
+}
+
+void pinMode(pin_t pin, PinMode mode)
+{
+    (void) pin;
+    (void) mode;
+}
+
+void digitalWrite(pin_t pin, uint8_t value)
+{
+    SIM_pins[pin] = value;
+}
+
+int32_t digitalRead(pin_t pin)
+{
+    std::vector<SIM_PinEvent_t>& events = SIM_pinEvents[pin];
+
+    while(!events.empty() && events.front().time <= millis())
+    {
+        SIM_pins[pin] = events.front().value;
+        events.erase(events.begin());
+    }
+    return SIM_pins[pin];
+}
+
+void SIM_setBatteryVoltage(float voltage)
+{
+    SIM_batteryVoltage = voltage;
+}
+
+float FuelGauge::getVCell(void)
+{
+    return SIM_batteryVoltage;
+}
+
+void SIM_setGPSFixTime(system_tick_t fixTime)
+{
+    SIM_gpsFixTime = fixTime;
+}
+
+/**
+ * @brief Appends an NMEA sentence with its checksum to the GPS buffer
+ * 
+ * @param body Sentence without the leading $ and the checksum
+ */
+static void SIM_putNMEA(const char* body)
+{
+    char sentence[128];
+    uint8_t checksum = 0;
+    const char* pChar;
+
+    for(pChar = body; *pChar; pChar++)
+    {
+        checksum ^= *pChar;
+    }
+    snprintf(sentence, sizeof(sentence), "$%s*%02X\r\n", body, checksum);
+    SIM_gpsBuffer += sentence;
+}
+
+/**
+ * @brief Generates the GPS reports due since the last call
+ * 
+ */
+static void SIM_updateGPS(void)
+{
+    char body[96];
+    system_tick_t now = millis();
+    uint32_t seconds;
+    bool hasFix;
+
+    if(SIM_gpsHasReported && now - SIM_gpsLastReport < 1000)
+    {
+        return;
+    }
+    SIM_gpsLastReport = now - now % 1000;
+    SIM_gpsHasReported = true;
+    if(SIM_gpsIdx >= SIM_gpsBuffer.size())
+    {
+        SIM_gpsBuffer.clear();
+        SIM_gpsIdx = 0;
+    }
+
+    // 2021-06-01 12:00:00 UTC plus uptime
+    seconds = 12 * 3600 + now / 1000;
+    hasFix = now >= SIM_gpsFixTime;
+    if(hasFix)
+    {
+        snprintf(body, sizeof(body), 
+            "GNRMC,%02lu%02lu%02lu.00,A,3252.1234,N,11715.4321,W,0.5,90.0,010621,,,A",
+            (unsigned long)(seconds / 3600 % 24), (unsigned long)(seconds / 60 % 60),
+            (unsigned long)(seconds % 60));
+        SIM_putNMEA(body);
+        snprintf(body, sizeof(body), 
+            "GNGGA,%02lu%02lu%02lu.00,3252.1234,N,11715.4321,W,1,08,1.0,0.0,M,-35.0,M,,",
+            (unsigned long)(seconds / 3600 % 24), (unsigned long)(seconds / 60 % 60),
+            (unsigned long)(seconds % 60));
+        SIM_putNMEA(body);
+    }
+    else
+    {
+        SIM_putNMEA("GNRMC,,V,,,,,,,,,,N");
+        SIM_putNMEA("GNGGA,,,,,,0,00,99.99,,,,,,");
+    }
+}
+
+extern "C" int GPS_kbhit(void)
+{
+    SIM_updateGPS();
+    return SIM_gpsIdx < SIM_gpsBuffer.size();
+}
+
+extern "C" int GPS_getch(void)
+{
+    SIM_updateGPS();
+    if(SIM_gpsIdx >= SIM_gpsBuffer.size())
+    {
+        return -1;
+    }
+    return SIM_gpsBuffer[SIM_gpsIdx++];
+}
+
+void SIM_setConsoleMode(SIM_ConsoleMode_e mode)
+{
+    SIM_consoleMode = mode;
+}
+
+extern "C" int SF_OSAL_printf(const char* fmt, ...)
+{
+    va_list vargs;
+    char buffer[SF_OSAL_PRINTF_BUFLEN];
+    int nBytes;
+
+    if(SIM_consoleMode == SIM_CONSOLE_QUIET)
+    {
+        return 0;
+    }
+    va_start(vargs, fmt);
+    nBytes = vsnprintf(buffer, SF_OSAL_PRINTF_BUFLEN, fmt, vargs);
+    va_end(vargs);
+    if(nBytes <= 0)
+    {
+        return nBytes;
+    }
+    if(SIM_consoleMode == SIM_CONSOLE_TIMESTAMPED && SIM_consoleLineStart)
+    {
+        printf("[%10.3f] ", SIM_time_us / 1e6);
+    }
+    fputs(buffer, stdout);
+    SIM_consoleLineStart = buffer[strlen(buffer) - 1] == '\n';
+    return nBytes;
+}
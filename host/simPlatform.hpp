@@ -0,0 +1,106 @@
+#ifndef __SIM_PLATFORM_HPP__
+#define __SIM_PLATFORM_HPP__
+/**
+ * @brief Virtual clock platform for host simulations
+ * 
+ * Time only moves when the firmware waits (delay, yield, sleep) or when a
+ * simulated peripheral charges time for an access, so a simulation runs as
+ * fast as the host allows and is repeatable.
+ * 
+ * Threads created with os_thread_create run cooperatively: a thread runs when
+ * the virtual clock reaches its wake time, and waiting (delay, yield) in a
+ * thread sets its next wake time and returns to the main thread.
+ */
+#include "Particle.h"
+
+/**
+ * @brief Time charged to each os_thread_yield call, in microseconds
+ * 
+ */
+#define SIM_YIELD_US    100
+
+/**
+ * @brief Modelled wakeup latency of a System.sleep call, in microseconds
+ * 
+ */
+#define SIM_SLEEP_WAKE_LATENCY_US   3000
+
+/**
+ * @brief Minimum stack size of a simulated thread, in bytes
+ * 
+ */
+#define SIM_THREAD_MIN_STACK_SIZE   (64 * 1024)
+
+/**
+ * @brief Advances the virtual clock, running any timers and threads that
+ * come due
+ * 
+ * Called from a thread, waits for the main thread to advance the clock
+ * instead.
+ * 
+ * @param us Microseconds to advance
+ */
+void SIM_advance(uint64_t us);
+
+/**
+ * @brief Returns the virtual time in microseconds since boot
+ * 
+ * @return uint64_t Virtual time
+ */
+uint64_t SIM_now(void);
+
+/**
+ * @brief Schedules a change of an input pin
+ * 
+ * Changes must be scheduled in increasing time order for each pin.
+ * 
+ * @param pin Pin to change
+ * @param value Value digitalRead returns from atTime
+ * @param atTime Virtual time of the change in ms
+ */
+void SIM_setPinInput(pin_t pin, uint8_t value, system_tick_t atTime);
+
+/**
+ * @brief Sets the voltage returned by FuelGauge::getVCell
+ * 
+ * @param voltage Cell voltage
+ */
+void SIM_setBatteryVoltage(float voltage);
+
+/**
+ * @brief Sets when the simulated GPS gets a fix
+ * 
+ * Before the fix, the GPS reports invalid fixes once per second.
+ * 
+ * @param fixTime Virtual time of the fix in ms
+ */
+void SIM_setGPSFixTime(system_tick_t fixTime);
+
+typedef enum SIM_ConsoleMode_
+{
+    /**
+     * @brief Discard firmware console output
+     * 
+     */
+    SIM_CONSOLE_QUIET,
+    /**
+     * @brief Print firmware console output, each line prefixed with the
+     * virtual time
+     * 
+     */
+    SIM_CONSOLE_TIMESTAMPED,
+    /**
+     * @brief Print firmware console output as is
+     * 
+     */
+    SIM_CONSOLE_PLAIN,
+}SIM_ConsoleMode_e;
+
+/**
+ * @brief Sets how SF_OSAL_printf output is handled
+ * 
+ * @param mode Console mode
+ */
+void SIM_setConsoleMode(SIM_ConsoleMode_e mode);
+
+#endif
@@ -0,0 +1,343 @@
+/**
+ * @brief Host-side benchmark of the storage stack
+ *
+ * Runs Deployment, Recorder and SPIFFS on a RAM flash that models the
+ * Smartfin flash timing, and reports the modelled flash time of appending
+ * packets, truncating them off again, removing a session and scanning the
+ * directory.  The file system is aged to each fill level first, so that the
+ * garbage collection stalls show up in the append latencies.  The time is
+ * the flash time only, so the results are the same on every host.
+ */
+#include "Particle.h"
+#include "ramFlash.hpp"
+
+#include "deploy.hpp"
+#include "nvram.hpp"
+#include "product.hpp"
+#include "recorder.hpp"
+#include "system.hpp"
+
+#include <algorithm>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * @brief Size of the flash, matches the Smartfin flash
+ *
+ */
+#define BENCH_FLASH_SIZE    (8 * 1024 * 1024)
+
+/**
+ * @brief Bytes written to the old files in turn when aging the file system
+ *
+ */
+#define BENCH_AGE_CHUNK_LEN 1024
+
+/**
+ * @brief Share of the file system written before the scratch file is
+ * deleted, in percent
+ *
+ */
+#define BENCH_AGE_PERCENT   90
+
+#define BENCH_SESSION_NAME  "Sfin-bench"
+
+static const uint32_t BENCH_fillLevels[] = {0, 25, 50, 75, 90};
+static const uint32_t BENCH_nFiles[] = {1, 16, 64, 128};
+
+static RamFlash BENCH_flash(BENCH_FLASH_SIZE);
+static SpiFlashPageBuffer BENCH_pageBuffer(BENCH_flash);
+static SpiffsParticle BENCH_fs(BENCH_pageBuffer);
+
+SystemDesc_t systemDesc, *pSystemDesc = &systemDesc;
+static SystemFlags_t BENCH_systemFlags;
+
+/**
+ * @brief Erases the flash and formats a new file system
+ *
+ * @return int 1 if successful, otherwise 0
+ */
+static int BENCH_resetFileSystem(void)
+{
+    BENCH_fs.unmount();
+    BENCH_pageBuffer.chipErase();
+    return BENCH_fs.mountAndFormatIfNecessary() == SPIFFS_OK;
+}
+
+/**
+ * @brief Leaves the file system with the given share of live data
+ *
+ * Interleaves a live file with a scratch file until the file system is
+ * nearly full, then deletes the scratch file, so the live data is spread
+ * over the blocks as it is after many sessions were recorded and uploaded.
+ *
+ * @param percent Live data as a percentage of the file system
+ * @return int 1 if successful, otherwise 0
+ */
+static int BENCH_ageFileSystem(uint32_t percent)
+{
+    SpiffsParticleFile files[2];
+    uint8_t buffer[BENCH_AGE_CHUNK_LEN];
+    uint32_t total, used;
+    uint32_t nLive = 0, nWritten = 0;
+    int live;
+
+    files[0] = BENCH_fs.openFile(".live", SPIFFS_O_CREAT | SPIFFS_O_TRUNC | SPIFFS_O_RDWR);
+    files[1] = BENCH_fs.openFile(".scratch", SPIFFS_O_CREAT | SPIFFS_O_TRUNC | SPIFFS_O_RDWR);
+    if(!files[0].isValid() || !files[1].isValid())
+    {
+        return 0;
+    }
+    memset(buffer, 0xA5, sizeof(buffer));
+    BENCH_fs.info(&total, &used);
+    while(used < (uint64_t) total * BENCH_AGE_PERCENT / 100)
+    {
+        // keep the live share of the chunks at percent
+        live = (nLive + 1) * 100 <= (uint64_t) (nWritten + 1) * percent;
+        if(files[live ? 0 : 1].write(buffer, sizeof(buffer)) != sizeof(buffer))
+        {
+            break;
+        }
+        nLive += live ? 1 : 0;
+        nWritten++;
+        BENCH_fs.info(&total, &used);
+    }
+    files[0].close();
+    files[1].remove();
+    files[1].close();
+    return 1;
+}
+
+/**
+ * @brief Returns the modelled flash time since the last call in us
+ *
+ * @return double Flash time
+ */
+static double BENCH_lap_us(void)
+{
+    static uint64_t last_ns;
+    uint64_t now_ns = BENCH_flash.getStats().busy_ns;
+    double lap_us = (now_ns - last_ns) / 1e3;
+
+    last_ns = now_ns;
+    return lap_us;
+}
+
+/**
+ * @brief Returns the pth percentile of the samples
+ *
+ * @param samples Samples, sorted in place
+ * @param p Percentile
+ * @return double Sample at the percentile
+ */
+static double BENCH_percentile(std::vector<double>& samples, uint32_t p)
+{
+    std::sort(samples.begin(), samples.end());
+    return samples[(samples.size() - 1) * p / 100];
+}
+
+/**
+ * @brief Appends packets to a new session, then truncates them off and
+ * removes the session
+ *
+ * @param fillPercent Live data left in the file system, in percent
+ * @param nPackets Packets to append
+ * @param nPops Packets to truncate off after appending
+ * @return int 1 if successful, otherwise 0
+ */
+static int BENCH_runAppend(uint32_t fillPercent, uint32_t nPackets, uint32_t nPops)
+{
+    static uint8_t packet[REC_MAX_PACKET_SIZE];
+    Deployment& session = Deployment::getInstance();
+    std::vector<double> writes_us, truncates_us;
+    uint32_t total, used;
+    uint32_t erases, nStalls = 0;
+    double append_us = 0, remove_us;
+    double p99_us, max_us, truncate_us = 0;
+    size_t length;
+    uint32_t i;
+
+    if(!BENCH_resetFileSystem() || !BENCH_ageFileSystem(fillPercent))
+    {
+        printf("Failed to age file system\n");
+        return 0;
+    }
+    BENCH_fs.info(&total, &used);
+    memset(packet, 0x5A, sizeof(packet));
+
+    // Deployment::open does not truncate, so start from a new file
+    BENCH_fs.remove(BENCH_SESSION_NAME);
+    if(!session.open(BENCH_SESSION_NAME, Deployment::WRITE))
+    {
+        printf("Failed to open session\n");
+        return 0;
+    }
+    BENCH_lap_us();
+    for(i = 0; i < nPackets; i++)
+    {
+        erases = BENCH_flash.getStats().sectorErases;
+        if(session.write(packet, sizeof(packet)) != sizeof(packet))
+        {
+            printf("File system full after %u packets\n", i);
+            break;
+        }
+        writes_us.push_back(BENCH_lap_us());
+        append_us += writes_us.back();
+        nStalls += BENCH_flash.getStats().sectorErases != erases ? 1 : 0;
+    }
+    session.close();
+    if(writes_us.empty())
+    {
+        return 0;
+    }
+
+    // pop packets off the end as the upload does
+    if(!session.open(BENCH_SESSION_NAME, Deployment::RDWR))
+    {
+        printf("Failed to reopen session\n");
+        return 0;
+    }
+    length = session.getLength();
+    BENCH_lap_us();
+    for(i = 0; i < nPops && length >= sizeof(packet); i++)
+    {
+        length -= sizeof(packet);
+        session.truncate(length);
+        truncates_us.push_back(BENCH_lap_us());
+    }
+    session.remove();
+    remove_us = BENCH_lap_us();
+    session.close();
+
+    p99_us = BENCH_percentile(writes_us, 99);
+    max_us = writes_us.back();
+    if(!truncates_us.empty())
+    {
+        truncate_us = BENCH_percentile(truncates_us, 50);
+    }
+    printf("%4u%% %4u%% %8.1f %8.1f %8.1f %8.1f %4u/%-4zu %9.1f %9.1f\n",
+        fillPercent, (uint32_t) ((uint64_t) used * 100 / total),
+        writes_us.size() * sizeof(packet) * 1e3 / append_us,
+        append_us / writes_us.size(), p99_us, max_us, nStalls, writes_us.size(),
+        truncate_us, remove_us / 1e3);
+    return 1;
+}
+
+/**
+ * @brief Times a directory scan and a session index rebuild over nFiles
+ * sessions of one packet each
+ *
+ * @param nFiles Sessions to create
+ * @return int 1 if successful, otherwise 0
+ */
+static int BENCH_runScan(uint32_t nFiles)
+{
+    static uint8_t packet[REC_MAX_PACKET_SIZE];
+    SpiffsParticleFile file;
+    spiffs_DIR dir;
+    spiffs_dirent dirEntry;
+    char name[SPIFFS_OBJ_NAME_LEN];
+    uint32_t nFound = 0;
+    double scan_us, rebuild_us;
+    uint32_t i;
+
+    if(!BENCH_resetFileSystem())
+    {
+        return 0;
+    }
+    memset(packet, 0x5A, sizeof(packet));
+    for(i = 0; i < nFiles; i++)
+    {
+        snprintf(name, sizeof(name), "%s-%u", BENCH_SESSION_NAME, i);
+        file = BENCH_fs.openFile(name, SPIFFS_O_CREAT | SPIFFS_O_TRUNC | SPIFFS_O_WRONLY);
+        if(!file.isValid() || file.write(packet, sizeof(packet)) != sizeof(packet))
+        {
+            printf("Failed to create %s\n", name);
+            return 0;
+        }
+        file.close();
+    }
+
+    BENCH_lap_us();
+    if(!BENCH_fs.opendir("", &dir))
+    {
+        return 0;
+    }
+    while(BENCH_fs.readdir(&dir, &dirEntry))
+    {
+        nFound++;
+    }
+    BENCH_fs.closedir(&dir);
+    scan_us = BENCH_lap_us();
+    pSystemDesc->pRecorder->rebuildIndex();
+    rebuild_us = BENCH_lap_us();
+
+    printf("%6u %6u %9.1f %9.1f\n", nFiles, nFound, scan_us / 1e3, rebuild_us / 1e3);
+    return 1;
+}
+
+static void BENCH_printUsage(const char* name)
+{
+    printf("Usage: %s [-n packets] [-p pops]\n", name);
+    printf("  -n  Packets appended at each fill level, default 128\n");
+    printf("  -p  Packets truncated off after appending, default 16\n");
+}
+
+int main(int argc, char** argv)
+{
+    static const RamFlashTiming_t timing = RAM_FLASH_TIMING_MX25L6406E;
+    static Recorder recorder;
+    uint32_t nPackets = 128;
+    uint32_t nPops = 16;
+    size_t i;
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:p:h")) != -1)
+    {
+        switch(opt)
+        {
+        case 'n':
+            nPackets = strtoul(optarg, NULL, 0);
+            break;
+        case 'p':
+            nPops = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            BENCH_printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    // same layout as SYS_initFS
+    memset(pSystemDesc, 0, sizeof(SystemDesc_t));
+    systemDesc.flags = &BENCH_systemFlags;
+    BENCH_pageBuffer.begin();
+    BENCH_flash.setTiming(timing, NULL);
+    BENCH_fs.withPhysicalAddr(SF_FLASH_SIZE_MB * 1024 * 1024);
+    systemDesc.pFileSystem = &BENCH_fs;
+    systemDesc.pNvram = &NVRAM::getInstance();
+    systemDesc.pRecorder = &recorder;
+
+    printf("Append %u packets of %u bytes, then truncate %u\n", nPackets, REC_MAX_PACKET_SIZE,
+        nPops);
+    printf("Live  Used     KB/s  mean us   p99 us   max us  stalls  trunc us remove ms\n");
+    for(i = 0; i < sizeof(BENCH_fillLevels) / sizeof(BENCH_fillLevels[0]); i++)
+    {
+        if(!BENCH_runAppend(BENCH_fillLevels[i], nPackets, nPops))
+        {
+            return 1;
+        }
+    }
+
+    printf("\nDirectory scan\n");
+    printf(" Files  Found   scan ms rebuild ms\n");
+    for(i = 0; i < sizeof(BENCH_nFiles) / sizeof(BENCH_nFiles[0]); i++)
+    {
+        if(!BENCH_runScan(BENCH_nFiles[i]))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
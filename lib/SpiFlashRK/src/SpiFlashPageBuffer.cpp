@@ -0,0 +1,133 @@
+#include "Particle.h"
+
+#include "SpiFlashRK.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+SpiFlashPageBuffer::SpiFlashPageBuffer(SpiFlashBase &flash) : flash(flash) {
+	pageSize = flash.getPageSize();
+	sectorSize = flash.getSectorSize();
+	resetStats();
+}
+
+SpiFlashPageBuffer::~SpiFlashPageBuffer() {
+	free(page);
+}
+
+void SpiFlashPageBuffer::begin() {
+	flash.begin();
+
+	// Without a buffer, writes go straight to the flash
+	if (!page) {
+		page = (uint8_t *)malloc(pageSize);
+	}
+	dirtyStart = dirtyEnd = 0;
+}
+
+bool SpiFlashPageBuffer::isValid() {
+	return flash.isValid();
+}
+
+uint32_t SpiFlashPageBuffer::jedecIdRead() {
+	return flash.jedecIdRead();
+}
+
+void SpiFlashPageBuffer::readData(size_t addr, void *buf, size_t bufLen) {
+	uint8_t *curBuf = (uint8_t *)buf;
+
+	flash.readData(addr, buf, bufLen);
+
+	if (dirtyStart == dirtyEnd || addr + bufLen <= pageAddr + dirtyStart || addr >= pageAddr + dirtyEnd) {
+		return;
+	}
+
+	// Programming can only clear bits, so the flash will read as its contents ANDed with the page
+	size_t start = (addr > pageAddr + dirtyStart) ? addr : pageAddr + dirtyStart;
+	size_t end = (addr + bufLen < pageAddr + dirtyEnd) ? addr + bufLen : pageAddr + dirtyEnd;
+	for(size_t ii = start; ii < end; ii++) {
+		curBuf[ii - addr] &= page[ii - pageAddr];
+	}
+}
+
+void SpiFlashPageBuffer::writeData(size_t addr, const void *buf, size_t bufLen) {
+	const uint8_t *curBuf = (const uint8_t *)buf;
+
+	stats.writeOps++;
+	stats.bytesWritten += bufLen;
+
+	if (!page) {
+		stats.pagePrograms += (addr % pageSize + bufLen + pageSize - 1) / pageSize;
+		stats.bytesProgrammed += bufLen;
+		flash.writeData(addr, buf, bufLen);
+		return;
+	}
+
+	while(bufLen > 0) {
+		size_t pageOffset = addr % pageSize;
+		size_t pageStart = addr - pageOffset;
+
+		size_t count = (pageStart + pageSize) - addr;
+		if (count > bufLen) {
+			count = bufLen;
+		}
+
+		if (dirtyStart != dirtyEnd && pageStart != pageAddr) {
+			sync();
+		}
+		if (dirtyStart == dirtyEnd) {
+			memset(page, 0xff, pageSize);
+			pageAddr = pageStart;
+			dirtyStart = pageOffset;
+			dirtyEnd = pageOffset + count;
+		}
+		else {
+			if (pageOffset < dirtyStart) {
+				dirtyStart = pageOffset;
+			}
+			if (pageOffset + count > dirtyEnd) {
+				dirtyEnd = pageOffset + count;
+			}
+		}
+
+		// Two writes to the same bytes program the AND of both, as the flash would
+		for(size_t ii = 0; ii < count; ii++) {
+			page[pageOffset + ii] &= curBuf[ii];
+		}
+
+		addr += count;
+		curBuf += count;
+		bufLen -= count;
+	}
+}
+
+void SpiFlashPageBuffer::sectorErase(size_t addr) {
+	size_t sectorStart = addr - (addr % sectorSize);
+
+	// A page in the sector would be erased anyway, otherwise keep the writes in order
+	if (dirtyStart != dirtyEnd && pageAddr >= sectorStart && pageAddr < sectorStart + sectorSize) {
+		dirtyStart = dirtyEnd = 0;
+	}
+	sync();
+	flash.sectorErase(addr);
+}
+
+void SpiFlashPageBuffer::chipErase() {
+	dirtyStart = dirtyEnd = 0;
+	flash.chipErase();
+}
+
+void SpiFlashPageBuffer::sync() {
+	if (dirtyStart == dirtyEnd) {
+		return;
+	}
+	stats.pagePrograms++;
+	stats.bytesProgrammed += dirtyEnd - dirtyStart;
+	flash.writeData(pageAddr + dirtyStart, &page[dirtyStart], dirtyEnd - dirtyStart);
+	dirtyStart = dirtyEnd = 0;
+}
+
+void SpiFlashPageBuffer::resetStats() {
+	memset(&stats, 0, sizeof(stats));
+}
@@ -0,0 +1,163 @@
+#include "Particle.h"
+
+#include "SpiFlashRK.h"
+
+#include <string.h>
+
+
+SpiFlashPowerManager::SpiFlashPowerManager(SpiFlashBase &flash) : flash(flash) {
+	pageSize = flash.getPageSize();
+	sectorSize = flash.getSectorSize();
+	memset(&stats, 0, sizeof(stats));
+}
+
+SpiFlashPowerManager::~SpiFlashPowerManager() {
+
+}
+
+void SpiFlashPowerManager::begin() {
+	lock();
+	// SpiFlash::begin also releases the chip from deep power down
+	flash.begin();
+	poweredDown = false;
+	unlock();
+	resetStats();
+}
+
+bool SpiFlashPowerManager::isValid() {
+	lock();
+	wakeIfNeeded();
+	bool result = flash.isValid();
+	unlock();
+	return result;
+}
+
+uint32_t SpiFlashPowerManager::jedecIdRead() {
+	lock();
+	wakeIfNeeded();
+	uint32_t result = flash.jedecIdRead();
+	unlock();
+	return result;
+}
+
+void SpiFlashPowerManager::readData(size_t addr, void *buf, size_t bufLen) {
+	lock();
+	wakeIfNeeded();
+	flash.readData(addr, buf, bufLen);
+	unlock();
+}
+
+void SpiFlashPowerManager::writeData(size_t addr, const void *buf, size_t bufLen) {
+	lock();
+	wakeIfNeeded();
+	flash.writeData(addr, buf, bufLen);
+	unlock();
+}
+
+void SpiFlashPowerManager::sectorErase(size_t addr) {
+	lock();
+	wakeIfNeeded();
+	flash.sectorErase(addr);
+	unlock();
+}
+
+void SpiFlashPowerManager::chipErase() {
+	lock();
+	wakeIfNeeded();
+	flash.chipErase();
+	unlock();
+}
+
+void SpiFlashPowerManager::sync() {
+	lock();
+	wakeIfNeeded();
+	flash.sync();
+	unlock();
+}
+
+void SpiFlashPowerManager::deepPowerDown() {
+	lock();
+	if (!poweredDown) {
+		flash.deepPowerDown();
+		poweredDown = true;
+		powerDownStart = millis();
+		stats.powerDowns++;
+	}
+	busy.clear(std::memory_order_release);
+}
+
+void SpiFlashPowerManager::wakeFromSleep() {
+	lock();
+	wakeIfNeeded();
+	unlock();
+}
+
+void SpiFlashPowerManager::process() {
+	if (busy.test_and_set(std::memory_order_acquire)) {
+		// An access is in progress, so the flash is not idle
+		return;
+	}
+	if (!poweredDown && millis() - lastAccess >= idleTimeMs) {
+		flash.deepPowerDown();
+		poweredDown = true;
+		powerDownStart = millis();
+		stats.powerDowns++;
+	}
+	busy.clear(std::memory_order_release);
+}
+
+SpiFlashPowerStats SpiFlashPowerManager::getStats() {
+	SpiFlashPowerStats result = stats;
+
+	if (poweredDown) {
+		result.powerDownTime_ms += millis() - powerDownStart;
+	}
+	result.elapsed_ms = millis() - statsStart;
+	return result;
+}
+
+float SpiFlashPowerManager::getSavedCurrent_uA() {
+	SpiFlashPowerStats current = getStats();
+
+	if (current.elapsed_ms == 0) {
+		return 0;
+	}
+	return (standbyCurrent_uA - powerDownCurrent_uA) * current.powerDownTime_ms / current.elapsed_ms;
+}
+
+void SpiFlashPowerManager::resetStats() {
+	memset(&stats, 0, sizeof(stats));
+	statsStart = millis();
+	if (poweredDown) {
+		powerDownStart = statsStart;
+	}
+}
+
+void SpiFlashPowerManager::lock() {
+	while(busy.test_and_set(std::memory_order_acquire)) {
+		os_thread_yield();
+	}
+}
+
+void SpiFlashPowerManager::unlock() {
+	lastAccess = millis();
+	busy.clear(std::memory_order_release);
+}
+
+void SpiFlashPowerManager::wakeIfNeeded() {
+	if (!poweredDown) {
+		return;
+	}
+
+	unsigned long start = micros();
+	flash.wakeFromSleep();
+	unsigned long wakeTime = micros() - start;
+
+	poweredDown = false;
+	stats.powerDownTime_ms += millis() - powerDownStart;
+	stats.wakes++;
+	stats.wakeTime_us += wakeTime;
+	if (wakeTime > stats.maxWakeTime_us) {
+		stats.maxWakeTime_us = wakeTime;
+	}
+}
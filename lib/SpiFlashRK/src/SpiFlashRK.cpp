@@ -93,10 +93,14 @@ void SpiFlash::waitForWriteComplete(unsigned long timeout) {
 
 	// Wait for up to 500 ms. Most operations should take much less than that.
 	while(isWriteInProgress() && millis() - startTime < timeout) {
-		// For long timeouts, yield the CPU
+		// For long timeouts, yield the CPU. A page program is only a millisecond or two, so
+		// let other threads run between polls instead of sleeping a whole tick.
 		if (timeout > 500) {
 			delay(1);
 		}
+		else {
+			os_thread_yield();
+		}
 	}
 
 	// Log.trace("isWriteInProgress=%d time=%u", isWriteInProgress(), millis() - startTime);
@@ -116,30 +120,19 @@ void SpiFlash::writeStatus(uint8_t status) {
 }
 
 void SpiFlash::readData(size_t addr, void *buf, size_t bufLen) {
-	uint8_t *curBuf = (uint8_t *)buf;
-
-	while(bufLen > 0) {
-		size_t pageOffset = addr % pageSize;
-		size_t pageStart = addr - pageOffset;
-
-		size_t count = (pageStart + pageSize) - addr;
-		if (count > bufLen) {
-			count = bufLen;
-		}
-
-		uint8_t txBuf[5];
+	if (bufLen == 0) {
+		return;
+	}
 
-		setInstWithAddr(0x03, addr, txBuf); // READ
+	uint8_t txBuf[5];
 
-		beginTransaction();
-		spi.transfer(txBuf, NULL, getInstWithAddrSize(), NULL);
-		spi.transfer(NULL, curBuf, bufLen, NULL);
-		endTransaction();
+	// READ continues across page boundaries, so one command reads the whole buffer
+	setInstWithAddr(0x03, addr, txBuf); // READ
 
-		addr += count;
-		curBuf += count;
-		bufLen -= count;
-	}
+	beginTransaction();
+	spi.transfer(txBuf, NULL, getInstWithAddrSize(), NULL);
+	transferData(NULL, buf, bufLen);
+	endTransaction();
 }
 
 
@@ -158,6 +151,27 @@ size_t SpiFlash::getInstWithAddrSize() const {
 	return addr4byte ? 5 : 4;	
 }
 
+volatile bool SpiFlash::dmaDone = true;
+
+// [static]
+void SpiFlash::dmaCompleteCallback() {
+	dmaDone = true;
+}
+
+void SpiFlash::transferData(const void *txBuf, void *rxBuf, size_t len) {
+	if (len < dmaMinLen) {
+		spi.transfer(const_cast<void *>(txBuf), rxBuf, len, NULL);
+		return;
+	}
+
+	// Let other threads run while the DMA clocks the data
+	dmaDone = false;
+	spi.transfer(const_cast<void *>(txBuf), rxBuf, len, dmaCompleteCallback);
+	while(!dmaDone) {
+		os_thread_yield();
+	}
+}
+
 
 void SpiFlash::writeData(size_t addr, const void *buf, size_t bufLen) {
 	uint8_t *curBuf = (uint8_t *)buf;
@@ -183,7 +197,7 @@ void SpiFlash::writeData(size_t addr, const void *buf, size_t bufLen) {
 
 		beginTransaction();
 		spi.transfer(txBuf, NULL, getInstWithAddrSize(), NULL);
-		spi.transfer(curBuf, NULL, count, NULL);
+		transferData(curBuf, NULL, count);
 		endTransaction();
 
 		waitForWriteComplete(pageProgramTimeoutMs);
@@ -288,6 +302,8 @@ void SpiFlash::wakeFromSleep() {
 
 // Note: not all chips support this. Macronix does.
 void SpiFlash::deepPowerDown() {
+	// The chip ignores deep power down while a write is in progress
+	waitForWriteComplete();
 
 	uint8_t txBuf[1];
 	txBuf[0] = 0xb9;
@@ -296,8 +312,9 @@ void SpiFlash::deepPowerDown() {
 	spi.transfer(txBuf, NULL, sizeof(txBuf), NULL);
 	endTransaction();
 
-	// Need to wait tdp (10 microseconds) before issuing the next command, but since we're probably doing
-	// this before sleep, it's not necessary
+	// Need to wait tdp (10 microseconds) before issuing the next command. SpiFlashPowerManager
+	// may wake the chip right after, so don't assume we're about to sleep.
+	delayMicroseconds(10);
 }
 
 
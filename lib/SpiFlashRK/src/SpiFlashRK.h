@@ -11,6 +11,8 @@
 
 #include "Particle.h"
 
+#include <atomic>
+
 /**
  * @brief Pure virtual base class SPI for SpiFlash devices
  *
@@ -78,6 +80,23 @@ public:
 	 */
 	virtual void chipErase() = 0;
 
+	/**
+	 * @brief Programs any writes that are still buffered. Writes are not buffered unless the
+	 * flash is wrapped in a SpiFlashPageBuffer, so by default this does nothing.
+	 */
+	virtual void sync() {};
+
+	/**
+	 * @brief Enters deep power down, if the flash supports it. Only wakeFromSleep() is accepted
+	 * until it wakes. Does nothing by default.
+	 */
+	virtual void deepPowerDown() {};
+
+	/**
+	 * @brief Wakes the flash from deep power down. Does nothing by default.
+	 */
+	virtual void wakeFromSleep() {};
+
 	/**
 	 * @brief Gets the page size (default: 256)
 	 */
@@ -223,7 +242,8 @@ public:
 	void wakeFromSleep();
 
 	/**
-	 * @brief Deep power down. Only supported by Macronix.
+	 * @brief Deep power down. Only supported by Macronix. Waits for any write in progress first,
+	 * since the chip ignores the command during a write.
 	 */
 	void deepPowerDown();
 
@@ -253,6 +273,15 @@ public:
 	 */
 	inline SpiFlash &withSpiClockSpeedMHz(uint8_t value) { spiClockSpeedMHz = value; return *this; };
 
+	/**
+	 * @brief Sets the shortest data transfer done by DMA (default: 32 bytes)
+	 *
+	 * Reads and page programs of at least this many bytes are clocked by DMA, and the calling
+	 * thread yields until the transfer completes, so other threads run meanwhile. Shorter
+	 * transfers are not worth setting up the DMA for.
+	 */
+	inline SpiFlash &withDmaMinLength(size_t value) { dmaMinLen = value; return *this; };
+
 	/**
 	 * @brief Sets shared bus mode
 	 *
@@ -320,6 +349,11 @@ protected:
 	 */
 	unsigned long writeEnableDelayUs = 3;
 
+	/**
+	 * @brief Shortest data transfer done by DMA, in bytes.
+	 */
+	size_t dmaMinLen = 32;
+
 private:
 	/**
 	 * @brief Enables writes to the status register, flash writes, and erases.
@@ -352,6 +386,20 @@ private:
 	 */
 	size_t getInstWithAddrSize() const;
 
+	/**
+	 * @brief Transfers the data phase of a read or page program, by DMA if it is at least
+	 * dmaMinLen bytes. Must be called inside a transaction.
+	 */
+	void transferData(const void *txBuf, void *rxBuf, size_t len);
+
+	/**
+	 * @brief DMA completion callback. The SPI API passes no context, so the flag is shared
+	 * by all SpiFlash objects, which is fine as long as they are used from one thread at a time.
+	 */
+	static void dmaCompleteCallback();
+
+	static volatile bool dmaDone;
+
 	SPIClass &spi;
 	int cs;
 	bool addr4byte = false;
@@ -406,6 +454,236 @@ public:
 
 };
 
+/**
+ * @brief Write counters of a SpiFlashPageBuffer
+ */
+typedef struct {
+	/**
+	 * @brief Number of writeData calls
+	 */
+	uint32_t writeOps;
+
+	/**
+	 * @brief Bytes passed to writeData
+	 */
+	uint32_t bytesWritten;
+
+	/**
+	 * @brief Number of page programs issued to the flash
+	 */
+	uint32_t pagePrograms;
+
+	/**
+	 * @brief Bytes sent to the flash in page programs
+	 */
+	uint32_t bytesProgrammed;
+} SpiFlashPageBufferStats;
+
+/**
+ * @brief Coalesces writes to the same page into one page program
+ *
+ * Wraps another flash object. Writes are merged into a one page buffer, and the page is
+ * programmed when a write goes to a different page, before an erase, or on sync(). Small
+ * writes to the same page, such as the SPIFFS page header, lookup entry and data of one
+ * page, then cost one program cycle and one command instead of one each. Writes reach the
+ * flash in the order they were made, so at most the writes to the buffered page are lost
+ * if power fails before the next sync().
+ *
+ * Reads return the buffered data, so the buffer is invisible to the file system.
+ */
+class SpiFlashPageBuffer : public SpiFlashBase {
+public:
+	/**
+	 * @brief Wraps a flash object. Uses its page and sector sizes, so set those first.
+	 */
+	SpiFlashPageBuffer(SpiFlashBase &flash);
+	virtual ~SpiFlashPageBuffer();
+
+	virtual void begin();
+	virtual bool isValid();
+	virtual uint32_t jedecIdRead();
+	virtual void readData(size_t addr, void *buf, size_t bufLen);
+	virtual void writeData(size_t addr, const void *buf, size_t bufLen);
+	virtual void sectorErase(size_t addr);
+	virtual void chipErase();
+
+	/**
+	 * @brief Programs the buffered page, if any
+	 */
+	virtual void sync();
+
+	/**
+	 * @brief Gets the write counters
+	 */
+	inline const SpiFlashPageBufferStats &getStats() const { return stats; };
+
+	/**
+	 * @brief Clears the write counters
+	 */
+	void resetStats();
+
+protected:
+	SpiFlashBase &flash;
+
+	/**
+	 * @brief Contents of the buffered page, 0xff where nothing was written
+	 */
+	uint8_t *page = 0;
+
+	/**
+	 * @brief Address of the buffered page
+	 */
+	size_t pageAddr = 0;
+
+	/**
+	 * @brief Range of the page that was written, empty if nothing is buffered
+	 */
+	size_t dirtyStart = 0;
+	size_t dirtyEnd = 0;
+
+	SpiFlashPageBufferStats stats;
+};
+
+/**
+ * @brief Counters of a SpiFlashPowerManager
+ */
+typedef struct {
+	/**
+	 * @brief Number of times the flash entered deep power down
+	 */
+	uint32_t powerDowns;
+
+	/**
+	 * @brief Number of times an access woke the flash
+	 */
+	uint32_t wakes;
+
+	/**
+	 * @brief Time spent waking the flash, added to the accesses that woke it, in microseconds
+	 */
+	uint32_t wakeTime_us;
+
+	/**
+	 * @brief Longest wake in microseconds
+	 */
+	uint32_t maxWakeTime_us;
+
+	/**
+	 * @brief Time in deep power down, in milliseconds
+	 */
+	uint32_t powerDownTime_ms;
+
+	/**
+	 * @brief Time since the counters were reset, in milliseconds
+	 */
+	uint32_t elapsed_ms;
+} SpiFlashPowerStats;
+
+/**
+ * @brief Puts the flash in deep power down when it is idle
+ *
+ * Wraps another flash object. process(), called periodically, powers the flash down once it
+ * has not been accessed for the idle time, and the next access wakes it first, so the file
+ * system never sees the difference. The flash draws its standby current between accesses
+ * otherwise, which over a ride of writes seconds apart is most of the time.
+ *
+ * Accesses and process() may run on different threads: a flag makes the power down wait for
+ * the end of an access, and an access wait for the end of a power down.
+ */
+class SpiFlashPowerManager : public SpiFlashBase {
+public:
+	/**
+	 * @brief Wraps a flash object. Uses its page and sector sizes, so set those first.
+	 */
+	SpiFlashPowerManager(SpiFlashBase &flash);
+	virtual ~SpiFlashPowerManager();
+
+	virtual void begin();
+	virtual bool isValid();
+	virtual uint32_t jedecIdRead();
+	virtual void readData(size_t addr, void *buf, size_t bufLen);
+	virtual void writeData(size_t addr, const void *buf, size_t bufLen);
+	virtual void sectorErase(size_t addr);
+	virtual void chipErase();
+	virtual void sync();
+
+	/**
+	 * @brief Powers the flash down now. The next access wakes it.
+	 */
+	virtual void deepPowerDown();
+
+	/**
+	 * @brief Wakes the flash now, if it is powered down
+	 */
+	virtual void wakeFromSleep();
+
+	/**
+	 * @brief Powers the flash down if it has been idle for the idle time. Call periodically,
+	 * from any thread. Returns immediately if an access is in progress.
+	 */
+	void process();
+
+	/**
+	 * @brief Sets the idle time before powering down (default: 250 ms)
+	 */
+	inline SpiFlashPowerManager &withIdleTimeMs(unsigned long value) { idleTimeMs = value; return *this; };
+
+	/**
+	 * @brief Sets the standby and deep power down currents used to estimate the saving
+	 * (default: 20 and 2 microamps)
+	 */
+	inline SpiFlashPowerManager &withCurrents(float standby_uA, float powerDown_uA) { standbyCurrent_uA = standby_uA; powerDownCurrent_uA = powerDown_uA; return *this; };
+
+	/**
+	 * @brief Returns true if the flash is in deep power down
+	 */
+	inline bool isPoweredDown() const { return poweredDown; };
+
+	/**
+	 * @brief Gets the counters, with the times brought up to now
+	 */
+	SpiFlashPowerStats getStats();
+
+	/**
+	 * @brief Returns the estimated standby current saved since the counters were reset, averaged
+	 * over that time, in microamps. This is also the charge saved per hour in microamp hours.
+	 */
+	float getSavedCurrent_uA();
+
+	/**
+	 * @brief Clears the counters
+	 */
+	void resetStats();
+
+protected:
+	/**
+	 * @brief Waits for any access or power down in progress, and claims the flash
+	 */
+	void lock();
+
+	/**
+	 * @brief Releases the flash, recording the time of the access
+	 */
+	void unlock();
+
+	/**
+	 * @brief Wakes the flash if it is powered down. Call with the flash claimed.
+	 */
+	void wakeIfNeeded();
+
+	SpiFlashBase &flash;
+	unsigned long idleTimeMs = 250;
+	float standbyCurrent_uA = 20.0;
+	float powerDownCurrent_uA = 2.0;
+
+	std::atomic_flag busy = ATOMIC_FLAG_INIT;
+	volatile bool poweredDown = false;
+	volatile unsigned long lastAccess = 0;
+	unsigned long powerDownStart = 0;
+	unsigned long statsStart = 0;
+	SpiFlashPowerStats stats;
+};
+
 // P1 platform only
 #if PLATFORM_ID==8
 
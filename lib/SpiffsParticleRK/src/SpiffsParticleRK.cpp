@@ -10,6 +10,8 @@
 
 #include "SpiffsParticleRK.h"
 
+#include "spiffs_nucleus.h"
+
 static Logger log("app.spiffs");
 
 static os_mutex_t _spiffsMutex = []() {
@@ -68,8 +70,18 @@ s32_t SpiffsParticle::mount(spiffs_check_callback callback) {
 	return SPIFFS_mount(&fs, &config, workBuffer, fdBuffer, fdBufferSize, cacheBuffer, cacheBufferSize, checkCallbackStatic);
 }
 
+void SpiffsParticle::flush() {
+	SPIFFS_flush(&fs);
+	spiffsParticleLock();
+	flash.sync();
+	spiffsParticleUnlock();
+}
+
 void SpiffsParticle::unmount() {
 	SPIFFS_unmount(&fs);
+	spiffsParticleLock();
+	flash.sync();
+	spiffsParticleUnlock();
 
 	free(workBuffer);
 	workBuffer = 0;
@@ -109,6 +121,20 @@ s32_t SpiffsParticle::erase() {
 }
 
 
+u32_t SpiffsParticle::getErasedBytes() {
+	s32_t freePages;
+
+	if (!mounted()) {
+		return 0;
+	}
+
+	// as spiffs_gc_check counts them
+	freePages = (SPIFFS_PAGES_PER_BLOCK(&fs) - SPIFFS_OBJ_LOOKUP_PAGES(&fs)) * (fs.block_count - 2)
+		- fs.stats_p_allocated - fs.stats_p_deleted;
+
+	return freePages > 0 ? freePages * SPIFFS_DATA_PAGE_SIZE(&fs) : 0;
+}
+
 s32_t SpiffsParticle::readCallback(u32_t addr, u32_t size, u8_t *dst) {
 	flash.readData(addr, dst, size);
 
@@ -273,6 +299,14 @@ int SpiffsParticleFile::peek() {
 }
 void SpiffsParticleFile::flush() {
 	SPIFFS_fflush(fs, fh);
+
+	// Also program the page the flash object may be buffering, under the
+	// SPIFFS lock as the buffer is shared with every other file system call
+	if (fs) {
+		spiffsParticleLock();
+		static_cast<SpiffsParticle *>(fs->user_data)->flash.sync();
+		spiffsParticleUnlock();
+	}
 }
 
 size_t SpiffsParticleFile::readBytes( char *buffer, size_t length) {
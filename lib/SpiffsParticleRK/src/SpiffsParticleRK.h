@@ -376,8 +376,10 @@ public:
 	 * but you want to make sure the data is saved. This saves having to mount the volume again.
 	 *
 	 * If you are using SLEEP_MODE_DEEP you should use unmount() instead.
+	 *
+	 * Also programs any writes the flash object is still buffering.
 	 */
-	inline void flush() { SPIFFS_flush(&fs); };
+	void flush();
 
 	/**
 	 * @brief Creates a new file.
@@ -593,6 +595,32 @@ public:
 	 */
 	inline s32_t info(u32_t *total, u32_t *used) { return SPIFFS_info(&fs, total, used); };
 
+	/**
+	 * @brief Tries to make room for the given number of bytes by moving pages and erasing blocks.
+	 *
+	 * Returns at once if that many bytes are already free. Each call erases at most
+	 * SPIFFS_GC_MAX_RUNS blocks, so call it again to free more.
+	 *
+	 * @param size          number of bytes to free
+	 */
+	inline s32_t gc(u32_t size) { return SPIFFS_gc(&fs, size); };
+
+	/**
+	 * @brief Erases one block whose pages are all deleted, without moving any pages.
+	 *
+	 * Returns SPIFFS_ERR_NO_DELETED_BLOCK if there is no such block.
+	 *
+	 * @param maxFreePages  most free pages allowed in the block
+	 */
+	inline s32_t gcQuick(u16_t maxFreePages) { return SPIFFS_gc_quick(&fs, maxFreePages); };
+
+	/**
+	 * @brief Returns the number of bytes that can be written before garbage collection is needed.
+	 *
+	 * Unlike info(), this does not count deleted pages, which have to be erased before reuse.
+	 */
+	u32_t getErasedBytes();
+
 	/**
 	 * @brief Returns nonzero if spiffs is mounted, or zero if unmounted.
 	 */
@@ -610,6 +638,9 @@ public:
 	static void traceLog(const char *fmt, ...);
 
 private:
+	// SpiffsParticleFile::flush() syncs the flash
+	friend class SpiffsParticleFile;
+
 	/**
 	 * @brief Use internally to read from flash
 	 */
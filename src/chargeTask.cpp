@@ -5,6 +5,7 @@
 #include "system.hpp"
 #include "sleepTask.hpp"
 #include "consts.h"
+#include "ride.hpp"
 
 static void byteshiftl(void* pData, size_t dataLen, size_t nPos, uint8_t fill);
 
@@ -18,6 +19,7 @@ void ChargeTask::init(void)
     this->ledStatus.setPriority(CHARGE_RGB_LED_PRIORITY);
     this->ledStatus.setActive();
     this->startTime = millis();
+    this->eraseAhead = 1;
 }
 
 STATES_e ChargeTask::run(void)
@@ -53,6 +55,12 @@ STATES_e ChargeTask::run(void)
             }
         }
 
+        // prepare the flash for the next ride, one bounded step at a time
+        if(this->eraseAhead)
+        {
+            this->eraseAhead = pSystemDesc->pRecorder->eraseAhead(RIDE_getExpectedLength());
+        }
+
         os_thread_yield();
     }
 }
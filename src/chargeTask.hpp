@@ -22,5 +22,6 @@ class ChargeTask : public Task{
     char inputBuffer[CLI_BUFFER_LEN];
     LEDStatus ledStatus;
     system_tick_t startTime;
+    int eraseAhead;
 };
 #endif
\ No newline at end of file
@@ -19,6 +19,9 @@
 #include "utils.hpp"
 #include "dataUpload.hpp"
 #include "base85.h"
+#include "ride.hpp"
+#include "tempCal.hpp"
+#include "scheduler.hpp"
 
 typedef const struct CLI_menu_
 {
@@ -97,6 +100,12 @@ static int CLI_clearFLOG(void);
 static int CLI_executeMfgPeripheralTest(void);
 static int CLI_testSleep(void);
 static int CLI_testUpload(void);
+static int CLI_displayScheduleStats(void);
+static int CLI_displayIdleStats(void);
+static int CLI_dumpEnsembleTiming(void);
+static int CLI_displayRecorderStats(void);
+static int CLI_displayFlashPowerStats(void);
+static int CLI_displayStorageForecast(void);
 
 const CLI_debugMenu_t CLI_debugMenu[] =
 {
@@ -115,6 +124,12 @@ const CLI_debugMenu_t CLI_debugMenu[] =
     {13, "Execute Mfg Peripheral Test", CLI_executeMfgPeripheralTest},
     {14, "Test Sleep", CLI_testSleep},
     {15, "Test Upload", CLI_testUpload},
+    {16, "Display Schedule Stats", CLI_displayScheduleStats},
+    {17, "Display Idle Stats", CLI_displayIdleStats},
+    {18, "Dump and Reset Ensemble Timing", CLI_dumpEnsembleTiming},
+    {19, "Display Recorder Queue Stats", CLI_displayRecorderStats},
+    {20, "Display Flash Power Stats", CLI_displayFlashPowerStats},
+    {21, "Display Storage Forecast", CLI_displayStorageForecast},
     {0, NULL, NULL}
 };
 
@@ -144,6 +159,7 @@ STATES_e CLI::run(void)
     CLI_menu_t *cmd;
     int i = 0;
     char userInput;
+    int eraseAhead = 1;
 
     CLI_nextState = STATE_CLI;
 
@@ -200,6 +216,11 @@ STATES_e CLI::run(void)
                 break;
             }
         }
+        else if (eraseAhead)
+        {
+            // prepare the flash for the next ride, one bounded step at a time
+            eraseAhead = pSystemDesc->pRecorder->eraseAhead(RIDE_getExpectedLength());
+        }
     }
     return CLI_nextState;
 }
@@ -303,6 +324,7 @@ static void CLI_doFormatFlash(void)
         return;
     }
     SF_OSAL_printf("*mount success\n");
+    pSystemDesc->pRecorder->rebuildIndex();
 }
 
 static void CLI_doCheckFS(void)
@@ -351,6 +373,7 @@ static void CLI_doMakeTestFiles(void)
     // }
     // bin_file.flush();
     // bin_file.close();
+    pSystemDesc->pRecorder->rebuildIndex();
     SF_OSAL_printf("Done making %d temp files!\n", nFiles);
 }
 
@@ -359,6 +382,7 @@ static void CLI_doReadDeleteFiles(void)
     FileCLI app;
     app = FileCLI();
     app.execute();
+    pSystemDesc->pRecorder->rebuildIndex();
 }
 
 static void CLI_doDebugMode(void)
@@ -680,6 +704,79 @@ static int CLI_clearFLOG(void)
     return 1;
 }
 
+static int CLI_displayScheduleStats(void)
+{
+    SF_OSAL_printf("Deployment schedule:\n");
+    SCH_displayStats(deploymentSchedule);
+    SF_OSAL_printf("Calibration schedule:\n");
+    SCH_displayStats(calibrateSchedule);
+    return 1;
+}
+
+static int CLI_displayIdleStats(void)
+{
+    SCH_displayIdleStats();
+    return 1;
+}
+
+static int CLI_dumpEnsembleTiming(void)
+{
+    SF_OSAL_printf("Deployment schedule:\n");
+    SCH_displayTiming(deploymentSchedule);
+    SCH_resetTiming(deploymentSchedule);
+    SF_OSAL_printf("Calibration schedule:\n");
+    SCH_displayTiming(calibrateSchedule);
+    SCH_resetTiming(calibrateSchedule);
+    return 1;
+}
+
+static int CLI_displayRecorderStats(void)
+{
+    pSystemDesc->pRecorder->displayQueueStats();
+    return 1;
+}
+
+static int CLI_displayFlashPowerStats(void)
+{
+    SpiFlashPowerManager* pFlashPower = pSystemDesc->pFlashPower;
+    SpiFlashPowerStats stats = pFlashPower->getStats();
+
+    SF_OSAL_printf("State:           %s\n", pFlashPower->isPoweredDown() ? "deep power down" : "standby");
+    SF_OSAL_printf("Power downs:     %lu\n", stats.powerDowns);
+    SF_OSAL_printf("Wakes:           %lu\n", stats.wakes);
+    SF_OSAL_printf("Wake latency:    %lu us total, %lu us longest\n", stats.wakeTime_us,
+        stats.maxWakeTime_us);
+    SF_OSAL_printf("Powered down:    %lu of %lu ms\n", stats.powerDownTime_ms, stats.elapsed_ms);
+    SF_OSAL_printf("Standby saved:   %.1f uAh per hour\n", pFlashPower->getSavedCurrent_uA());
+    return 1;
+}
+
+static int CLI_displayStorageForecast(void)
+{
+    REC_StorageForecast_t forecast;
+
+    if (!RIDE_getStorageForecast(&forecast))
+    {
+        SF_OSAL_printf("Failed to read file system usage\n");
+        return 0;
+    }
+    SF_OSAL_printf("Used:            %lu of %lu kB\n", forecast.usedBytes / 1024,
+        forecast.totalBytes / 1024);
+    SF_OSAL_printf("Ride rate:       %lu bytes per minute, %s\n", forecast.bytesPerMinute,
+        forecast.measured ? "measured" : "from the schedule");
+    SF_OSAL_printf("Padding:         %u%%\n", forecast.paddingPercent);
+    if (UINT32_MAX == forecast.minutesRemaining)
+    {
+        SF_OSAL_printf("Ride remaining:  unlimited\n");
+    }
+    else
+    {
+        SF_OSAL_printf("Ride remaining:  %lu h %02lu min\n", forecast.minutesRemaining / 60,
+            forecast.minutesRemaining % 60);
+    }
+    return 1;
+}
+
 static void CLI_doCalibrateMode(void)
 {
     char userInput[32];
@@ -807,7 +904,8 @@ static int CLI_testSleep(void)
     sscanf(userInput, "%lu", &sleepTime);
     SF_OSAL_printf("Sleeping for %u s\n", sleepTime);
     start = Time.now();
-    UTIL_sleepUntil(millis() + sleepTime * 1000);
+    // keep USB serial up for the CLI session
+    UTIL_sleepUntil(millis() + sleepTime * 1000, SCH_IDLE_DELAY);
     stop = Time.now();
     do
     {
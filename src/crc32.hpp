@@ -0,0 +1,26 @@
+#ifndef __CRC32_HPP__
+#define __CRC32_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Initial value of a CRC-32
+ * 
+ */
+#define CRC32_INIT  0
+
+/**
+ * @brief Updates a CRC-32 (IEEE 802.3, as used by zlib) with more data
+ * 
+ * Table driven, one table lookup per byte.  Pass CRC32_INIT as crc for the
+ * first block, and the returned CRC for each following block.
+ * 
+ * @param crc CRC of the preceding data
+ * @param pData Data
+ * @param nBytes Number of bytes of data
+ * @return uint32_t CRC of the preceding data and pData
+ */
+uint32_t CRC32_update(uint32_t crc, const void* pData, size_t nBytes);
+
+#endif
@@ -9,12 +9,14 @@
 #include "base64.h"
 #include "sleepTask.hpp"
 #include "flog.hpp"
+#include "ride.hpp"
 
 void DataUpload::init(void)
 {
     SF_OSAL_printf("Entering SYSTEM_STATE_DATA_UPLOAD\n");
 
     this->initSuccess = 0;
+    this->eraseAhead = 1;
     Particle.connect();
     os_thread_yield();
     this->initSuccess = 1;
@@ -34,6 +36,7 @@ STATES_e DataUpload::run(void)
     if(!this->initSuccess)
     {
         SF_OSAL_printf("Failed to init\n");
+        this->eraseAhead = 0;
         return STATE_DEEP_SLEEP;
     }
 
@@ -56,6 +59,7 @@ STATES_e DataUpload::run(void)
         {
             SF_OSAL_printf("Battery low\n");
             FLOG_AddError(FLOG_UPL_BATT_LOW, (uint16_t) (pSystemDesc->pBattery->getVCell() * 1000));
+            this->eraseAhead = 0;
             return STATE_DEEP_SLEEP;
         }
 
@@ -169,7 +173,7 @@ STATES_e DataUpload::run(void)
         lastSendTime = millis();
 
 
-        if(!pSystemDesc->pRecorder->popLastPacket(nBytesToEncode))
+        if(!pSystemDesc->pRecorder->popLastPacket())
         {
             SF_OSAL_printf("Failed to trim!");
             return STATE_CLI;
@@ -179,7 +183,29 @@ STATES_e DataUpload::run(void)
 
 void DataUpload::exit(void)
 {
+    system_tick_t startTime;
+    system_tick_t lastWaterCheck;
+    uint8_t inWater;
+
     Cellular.off();
+    if(!this->eraseAhead)
+    {
+        // not worth the battery, or the recorder may not be usable
+        return;
+    }
+
+    // prepare the flash for the next ride before sleeping, unless it started
+    startTime = lastWaterCheck = millis();
+    inWater = pSystemDesc->pWaterSensor->getCurrentReading();
+    while(!inWater && millis() - startTime < SF_UPLOAD_ERASE_AHEAD_MS &&
+        pSystemDesc->pRecorder->eraseAhead(RIDE_getExpectedLength()))
+    {
+        if(millis() - lastWaterCheck >= DU_ERASE_AHEAD_WATER_CHECK_MS)
+        {
+            lastWaterCheck = millis();
+            inWater = pSystemDesc->pWaterSensor->getCurrentReading();
+        }
+    }
 }
 
 STATES_e DataUpload::exitState(void)
@@ -53,6 +53,12 @@
  */
 #define DU_UPLOAD_MAX_REATTEMPTS    5
 
+/**
+ * @brief Interval between water checks while erasing flash on exit, in ms
+ * 
+ */
+#define DU_ERASE_AHEAD_WATER_CHECK_MS   1000
+
 
 class DataUpload : public Task{
     public:
@@ -63,6 +69,12 @@ class DataUpload : public Task{
     private:
     spiffs_DIR dir;
     int initSuccess;
+    /**
+     * @brief Erase flash for the next ride on exit, cleared when the upload
+     * ends on a low battery or a failed init
+     * 
+     */
+    int eraseAhead;
     system_tick_t lastConnectTime;
     STATES_e exitState(void);
 };
@@ -48,18 +48,46 @@ int Deployment::open(const char* const name, Deployment::State_e state)
     }
 }
 
+/**
+ * @brief Writes to the deployment
+ * 
+ * The data may stay in the file system's write cache until the next flush
+ * or close.
+ * 
+ * @param pData Data to write
+ * @param nBytes Number of bytes to write
+ * @return int Number of bytes written
+ */
 int Deployment::write(void* pData, size_t nBytes)
 {
     size_t bytesWritten = 0;
-    if(!this->currentFile.isValid() || currentState != Deployment::WRITE)
+    if(!this->currentFile.isValid())
+    {
+        return 0;
+    }
+    if(this->currentState != Deployment::WRITE && this->currentState != Deployment::RDWR)
     {
         return 0;
     }
     bytesWritten = this->currentFile.write((uint8_t*) pData, nBytes);
-    this->currentFile.flush();
     return bytesWritten;
 }
 
+/**
+ * @brief Commits cached writes to flash
+ * 
+ * @return int 1 if successful, otherwise 0
+ */
+int Deployment::flush(void)
+{
+    if(!this->currentFile.isValid())
+    {
+        return 0;
+    }
+    this->currentFile.flush();
+    return 1;
+}
+
 int Deployment::read(void* pData, size_t nBytes)
 {
     size_t bytesRead = 0;
@@ -18,6 +18,7 @@ class Deployment
 
     int open(const char* const name, State_e state);
     int write(void* pData, size_t nBytes);
+    int flush(void);
     int read(void* pData, size_t nBytes);
     int seek(size_t loc);
     size_t getLength(void);
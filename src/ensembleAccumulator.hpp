@@ -0,0 +1,274 @@
+#ifndef __ENSEMBLE_ACCUMULATOR_HPP__
+#define __ENSEMBLE_ACCUMULATOR_HPP__
+/**
+ * @brief Integer accumulator for ensemble measurements
+ *
+ * EnsembleAccumulator<Fields...> keeps one sum per field, wide enough that
+ * maxSamples samples cannot overflow it, and a sample count.  Adding a sample
+ * is integer adds only.  When a record is complete, putMeans writes the
+ * rounded mean of each field, big-endian and sizeof(Field) bytes wide, in
+ * field order, directly into the record buffer.
+ *
+ *     EnsembleAccumulator<int16_t, int16_t, int16_t> accel;
+ *
+ *     accel.add(x, y, z);
+ *     if(accel.getCount() == N)
+ *     {
+ *         pBuffer = accel.putMeans(pBuffer);
+ *         accel.reset();
+ *     }
+ *
+ * Accumulators are plain data, so zero filling one also resets it.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Sum type of an accumulated field
+ *
+ * @tparam Field Sample type
+ */
+template <typename Field> struct EnsembleSum;
+
+template <> struct EnsembleSum<int8_t>
+{
+    typedef int32_t type;
+    static constexpr uint32_t maxSamples = INT32_MAX / (-(int32_t) INT8_MIN);
+};
+
+template <> struct EnsembleSum<uint8_t>
+{
+    typedef uint32_t type;
+    static constexpr uint32_t maxSamples = UINT32_MAX / UINT8_MAX;
+};
+
+template <> struct EnsembleSum<int16_t>
+{
+    typedef int32_t type;
+    static constexpr uint32_t maxSamples = INT32_MAX / (-(int32_t) INT16_MIN);
+};
+
+template <> struct EnsembleSum<uint16_t>
+{
+    typedef uint32_t type;
+    static constexpr uint32_t maxSamples = UINT32_MAX / UINT16_MAX;
+};
+
+template <> struct EnsembleSum<int32_t>
+{
+    typedef int64_t type;
+    static constexpr uint32_t maxSamples = UINT32_MAX;
+};
+
+template <> struct EnsembleSum<uint32_t>
+{
+    typedef uint64_t type;
+    static constexpr uint32_t maxSamples = UINT32_MAX;
+};
+
+/**
+ * @brief Divides a sum by a count, rounding half away from zero
+ *
+ * @tparam Field Sample type
+ * @param sum Sum of count samples
+ * @param count Number of samples, must be nonzero
+ * @return Field Mean
+ */
+template <typename Field> inline Field Ens_roundedMean(typename EnsembleSum<Field>::type sum, uint32_t count)
+{
+    typedef typename EnsembleSum<Field>::type Sum;
+    if(sum < 0)
+    {
+        return (Field) ((sum - (Sum) (count / 2)) / (Sum) count);
+    }
+    return (Field) ((sum + (Sum) (count / 2)) / (Sum) count);
+}
+
+/**
+ * @brief Writes a value big-endian
+ *
+ * @tparam T Value type
+ * @param pBuffer Buffer to write sizeof(T) bytes into
+ * @param value Value to write
+ * @return uint8_t* First byte after the value
+ */
+template <typename T> inline uint8_t* Ens_putBigEndian(uint8_t* pBuffer, T value)
+{
+    size_t i;
+    for(i = 0; i < sizeof(T); i++)
+    {
+        pBuffer[i] = (uint8_t) ((uint64_t) value >> (8 * (sizeof(T) - 1 - i)));
+    }
+    return pBuffer + sizeof(T);
+}
+
+/**
+ * @brief Sums of a list of fields
+ *
+ */
+template <typename... Fields> struct EnsembleSums
+{
+};
+
+template <typename Field, typename... Rest> struct EnsembleSums<Field, Rest...>
+{
+    typename EnsembleSum<Field>::type sum;
+    EnsembleSums<Rest...> rest;
+
+    void add(Field sample, Rest... samples)
+    {
+        this->sum += sample;
+        this->rest.add(samples...);
+    }
+
+    uint8_t* putMeans(uint8_t* pBuffer, uint32_t count) const
+    {
+        pBuffer = Ens_putBigEndian<Field>(pBuffer, Ens_roundedMean<Field>(this->sum, count));
+        return this->rest.putMeans(pBuffer, count);
+    }
+};
+
+template <> struct EnsembleSums<>
+{
+    void add(void)
+    {
+    }
+
+    uint8_t* putMeans(uint8_t* pBuffer, uint32_t count) const
+    {
+        (void) count;
+        return pBuffer;
+    }
+};
+
+/**
+ * @brief Type and sum of the field at an index
+ *
+ */
+template <size_t I, typename... Fields> struct EnsembleField;
+
+template <typename Field, typename... Rest> struct EnsembleField<0, Field, Rest...>
+{
+    typedef Field type;
+    static typename EnsembleSum<Field>::type getSum(const EnsembleSums<Field, Rest...>& sums)
+    {
+        return sums.sum;
+    }
+};
+
+template <size_t I, typename Field, typename... Rest> struct EnsembleField<I, Field, Rest...>
+{
+    typedef typename EnsembleField<I - 1, Rest...>::type type;
+    static typename EnsembleSum<type>::type getSum(const EnsembleSums<Field, Rest...>& sums)
+    {
+        return EnsembleField<I - 1, Rest...>::getSum(sums.rest);
+    }
+};
+
+/**
+ * @brief Smallest maximum sample count of a list of fields
+ *
+ */
+template <typename... Fields> struct EnsembleMaxSamples
+{
+    static constexpr uint32_t value = UINT32_MAX;
+};
+
+template <typename Field, typename... Rest> struct EnsembleMaxSamples<Field, Rest...>
+{
+    static constexpr uint32_t value =
+        EnsembleSum<Field>::maxSamples < EnsembleMaxSamples<Rest...>::value ?
+        EnsembleSum<Field>::maxSamples : EnsembleMaxSamples<Rest...>::value;
+};
+
+/**
+ * @brief Total size of a list of fields
+ *
+ */
+template <typename... Fields> struct EnsembleFieldsSize
+{
+    static constexpr size_t value = 0;
+};
+
+template <typename Field, typename... Rest> struct EnsembleFieldsSize<Field, Rest...>
+{
+    static constexpr size_t value = sizeof(Field) + EnsembleFieldsSize<Rest...>::value;
+};
+
+/**
+ * @brief Accumulator of samples of one or more integer fields
+ *
+ * @tparam Fields Sample type of each field
+ */
+template <typename... Fields> class EnsembleAccumulator
+{
+    public:
+    /**
+     * @brief Number of samples that can be accumulated without overflow
+     *
+     */
+    static constexpr uint32_t maxSamples = EnsembleMaxSamples<Fields...>::value;
+
+    /**
+     * @brief Number of bytes written by putMeans
+     *
+     */
+    static constexpr size_t meansSize = EnsembleFieldsSize<Fields...>::value;
+
+    /**
+     * @brief Adds one sample of every field
+     *
+     * @param samples One sample of each field, in field order
+     */
+    void add(Fields... samples)
+    {
+        this->sums.add(samples...);
+        this->count++;
+    }
+
+    uint32_t getCount(void) const
+    {
+        return this->count;
+    }
+
+    /**
+     * @brief Returns the rounded mean of one field
+     *
+     * @tparam I Field index
+     * @return Mean of the field, or 0 if no samples were added
+     */
+    template <size_t I> typename EnsembleField<I, Fields...>::type getMean(void) const
+    {
+        typedef typename EnsembleField<I, Fields...>::type Field;
+        if(this->count == 0)
+        {
+            return 0;
+        }
+        return Ens_roundedMean<Field>(EnsembleField<I, Fields...>::getSum(this->sums), this->count);
+    }
+
+    /**
+     * @brief Writes the rounded mean of each field, big-endian, in field order
+     *
+     * Must not be called before a sample is added.
+     *
+     * @param pBuffer Buffer to write meansSize bytes into
+     * @return uint8_t* First byte after the means
+     */
+    uint8_t* putMeans(uint8_t* pBuffer) const
+    {
+        return this->sums.putMeans(pBuffer, this->count);
+    }
+
+    void reset(void)
+    {
+        this->sums = EnsembleSums<Fields...>();
+        this->count = 0;
+    }
+
+    private:
+    EnsembleSums<Fields...> sums;
+    uint32_t count;
+};
+
+#endif
@@ -0,0 +1,280 @@
+#include "ensembleCodec.hpp"
+
+#include <string.h>
+
+/**
+ * @brief Fields of a delta encoded ensemble, in record order
+ *
+ * Each field is big-endian, width bytes wide.  Negative widths are signed
+ * fields.
+ */
+typedef struct EnsembleLayout_
+{
+    uint8_t nFields;
+    int8_t widths[ENS_CODEC_MAX_FIELDS];
+}EnsembleLayout_t;
+
+/**
+ * @brief Most bytes of a varint
+ *
+ */
+#define ENS_VARINT_MAX_LEN  5
+
+static_assert(sizeof(Ensemble07_data_t) == 2, "Ensemble 07 layout");
+static_assert(sizeof(Ensemble08_data_t) == 2 + 4, "Ensemble 08 layout");
+static_assert(sizeof(Ensemble10_data_t) == 10 * 2, "Ensemble 10 layout");
+static_assert(sizeof(Ensemble11_data_t) == 10 * 2 + 2 * 4, "Ensemble 11 layout");
+static_assert(sizeof(Ensemble12_data_t) == 3 * 2 + 2 * 1, "Ensemble 12 layout");
+
+/**
+ * @brief Field layouts by ensemble type, types without fields are stored raw
+ *
+ */
+static const EnsembleLayout_t ENS_layouts[ENS_NUM_ENSEMBLES] =
+{
+    {0, {}},
+    {0, {}},    // ENS_TEMP
+    {0, {}},    // ENS_ACC
+    {0, {}},    // ENS_GPS
+    {0, {}},    // ENS_TEMP_ACC
+    {0, {}},    // ENS_TEMP_GPS
+    {0, {}},    // ENS_TEMP_ACC_GPS
+    {1, {2}},   // ENS_BATT
+    {2, {-2, 4}},   // ENS_TEMP_TIME
+    {0, {}},    // ENS_IMU
+    {10, {-2, -2, -2, -2, -2, -2, -2, -2, -2, -2}},   // ENS_TEMP_IMU
+    {12, {-2, -2, -2, -2, -2, -2, -2, -2, -2, -2, -4, -4}},   // ENS_TEMP_IMU_GPS
+    {5, {2, 2, 2, 1, 1}},   // ENS_STORAGE
+    {0, {}},
+    {0, {}},
+    {0, {}},    // ENS_TEXT
+};
+
+static uint8_t* Ens_putVarint(uint8_t* pBuffer, uint32_t value);
+static int Ens_getVarint(const uint8_t* pBuffer, const uint8_t* pEnd, uint32_t* pValue);
+static size_t Ens_getLayoutSize(const EnsembleLayout_t* pLayout);
+
+static inline uint32_t Ens_zigzag(uint32_t delta)
+{
+    return (delta << 1) ^ (uint32_t) ((int32_t) delta >> 31);
+}
+
+static inline uint32_t Ens_unzigzag(uint32_t value)
+{
+    return (value >> 1) ^ (0 - (value & 1));
+}
+
+void Ens_resetCodec(EnsembleCodec_t* pCodec)
+{
+    memset(pCodec, 0, sizeof(EnsembleCodec_t));
+}
+
+size_t Ens_encodeRecord(EnsembleCodec_t* pCodec, const uint8_t* pRecord, size_t nBytes, uint8_t* pOut)
+{
+    EnsembleHeader_t header;
+    const EnsembleLayout_t* pLayout;
+    uint8_t deltaRecord[1 + ENS_VARINT_MAX_LEN * (1 + ENS_CODEC_MAX_FIELDS)];
+    uint32_t fields[ENS_CODEC_MAX_FIELDS];
+    uint8_t* pDelta = deltaRecord;
+    uint8_t* pRaw = pOut;
+    const uint8_t* pField;
+    size_t rawLen;
+    size_t width;
+    size_t i, j;
+
+    *pRaw++ = ENS_CODEC_RAW;
+    pRaw = Ens_putVarint(pRaw, nBytes);
+    rawLen = (pRaw - pOut) + nBytes;
+
+    if(nBytes < sizeof(EnsembleHeader_t))
+    {
+        memcpy(pRaw, pRecord, nBytes);
+        return rawLen;
+    }
+    memcpy(&header, pRecord, sizeof(EnsembleHeader_t));
+    pLayout = &ENS_layouts[header.ensembleType];
+    if(0 == pLayout->nFields || nBytes != sizeof(EnsembleHeader_t) + Ens_getLayoutSize(pLayout))
+    {
+        memcpy(pRaw, pRecord, nBytes);
+        return rawLen;
+    }
+
+    *pDelta++ = header.ensembleType;
+    pDelta = Ens_putVarint(pDelta,
+        Ens_zigzag(header.elapsedTime_ds - pCodec->elapsedTime_ds[header.ensembleType]));
+    pField = pRecord + sizeof(EnsembleHeader_t);
+    for(i = 0; i < pLayout->nFields; i++)
+    {
+        width = pLayout->widths[i] < 0 ? -pLayout->widths[i] : pLayout->widths[i];
+        fields[i] = (pLayout->widths[i] < 0 && (pField[0] & 0x80)) ? UINT32_MAX : 0;
+        for(j = 0; j < width; j++)
+        {
+            fields[i] = (fields[i] << 8) | *pField++;
+        }
+        pDelta = Ens_putVarint(pDelta,
+            Ens_zigzag(fields[i] - pCodec->fields[header.ensembleType][i]));
+    }
+
+    if((size_t) (pDelta - deltaRecord) >= rawLen)
+    {
+        memcpy(pRaw, pRecord, nBytes);
+        return rawLen;
+    }
+    pCodec->elapsedTime_ds[header.ensembleType] = header.elapsedTime_ds;
+    memcpy(pCodec->fields[header.ensembleType], fields, pLayout->nFields * sizeof(uint32_t));
+    memcpy(pOut, deltaRecord, pDelta - deltaRecord);
+    return pDelta - deltaRecord;
+}
+
+int Ens_decodeRecord(EnsembleCodec_t* pCodec, const uint8_t* pIn, size_t nIn, uint8_t* pRecord, size_t* pRecordLen)
+{
+    const uint8_t* pEnd = pIn + nIn;
+    const uint8_t* pNext = pIn;
+    const EnsembleLayout_t* pLayout;
+    EnsembleHeader_t header;
+    uint8_t type;
+    uint32_t value;
+    uint32_t fields[ENS_CODEC_MAX_FIELDS];
+    uint8_t* pField;
+    size_t recordLen;
+    size_t width;
+    size_t i, j;
+    int nBytes;
+
+    if(nIn == 0)
+    {
+        return 0;
+    }
+    type = *pNext++;
+    if(type >= ENS_NUM_ENSEMBLES)
+    {
+        return -1;
+    }
+
+    if(type == ENS_CODEC_RAW)
+    {
+        nBytes = Ens_getVarint(pNext, pEnd, &value);
+        if(nBytes <= 0)
+        {
+            return nBytes;
+        }
+        pNext += nBytes;
+        if(value > *pRecordLen)
+        {
+            return -1;
+        }
+        if(value > (size_t) (pEnd - pNext))
+        {
+            return 0;
+        }
+        memcpy(pRecord, pNext, value);
+        *pRecordLen = value;
+        return (pNext - pIn) + value;
+    }
+
+    pLayout = &ENS_layouts[type];
+    recordLen = sizeof(EnsembleHeader_t) + Ens_getLayoutSize(pLayout);
+    if(0 == pLayout->nFields || recordLen > *pRecordLen)
+    {
+        return -1;
+    }
+    nBytes = Ens_getVarint(pNext, pEnd, &value);
+    if(nBytes <= 0)
+    {
+        return nBytes;
+    }
+    pNext += nBytes;
+    header.ensembleType = type;
+    header.elapsedTime_ds = pCodec->elapsedTime_ds[type] + Ens_unzigzag(value);
+    for(i = 0; i < pLayout->nFields; i++)
+    {
+        nBytes = Ens_getVarint(pNext, pEnd, &value);
+        if(nBytes <= 0)
+        {
+            return nBytes;
+        }
+        pNext += nBytes;
+        fields[i] = pCodec->fields[type][i] + Ens_unzigzag(value);
+    }
+
+    pCodec->elapsedTime_ds[type] = header.elapsedTime_ds;
+    memcpy(pCodec->fields[type], fields, pLayout->nFields * sizeof(uint32_t));
+    memcpy(pRecord, &header, sizeof(EnsembleHeader_t));
+    pField = pRecord + sizeof(EnsembleHeader_t);
+    for(i = 0; i < pLayout->nFields; i++)
+    {
+        width = pLayout->widths[i] < 0 ? -pLayout->widths[i] : pLayout->widths[i];
+        for(j = 0; j < width; j++)
+        {
+            *pField++ = (uint8_t) (fields[i] >> (8 * (width - 1 - j)));
+        }
+    }
+    *pRecordLen = recordLen;
+    return pNext - pIn;
+}
+
+/**
+ * @brief Writes a little-endian base 128 varint
+ *
+ * @param pBuffer Buffer to write up to ENS_VARINT_MAX_LEN bytes into
+ * @param value Value
+ * @return uint8_t* First byte after the varint
+ */
+static uint8_t* Ens_putVarint(uint8_t* pBuffer, uint32_t value)
+{
+    while(value >= 0x80)
+    {
+        *pBuffer++ = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    *pBuffer++ = (uint8_t) value;
+    return pBuffer;
+}
+
+/**
+ * @brief Reads a little-endian base 128 varint
+ *
+ * @param pBuffer Varint
+ * @param pEnd End of the buffer
+ * @param pValue Value read
+ * @return int Number of bytes read, 0 if the buffer ends within the varint,
+ * or -1 if the varint is too long
+ */
+static int Ens_getVarint(const uint8_t* pBuffer, const uint8_t* pEnd, uint32_t* pValue)
+{
+    uint32_t value = 0;
+    int i;
+
+    for(i = 0; i < ENS_VARINT_MAX_LEN; i++)
+    {
+        if(pBuffer + i >= pEnd)
+        {
+            return 0;
+        }
+        value |= (uint32_t) (pBuffer[i] & 0x7F) << (7 * i);
+        if(0 == (pBuffer[i] & 0x80))
+        {
+            *pValue = value;
+            return i + 1;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Returns the number of bytes of fields of a layout
+ *
+ * @param pLayout Layout
+ * @return size_t Size of the record without its header
+ */
+static size_t Ens_getLayoutSize(const EnsembleLayout_t* pLayout)
+{
+    size_t size = 0;
+    size_t i;
+
+    for(i = 0; i < pLayout->nFields; i++)
+    {
+        size += pLayout->widths[i] < 0 ? -pLayout->widths[i] : pLayout->widths[i];
+    }
+    return size;
+}
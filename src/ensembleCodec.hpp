@@ -0,0 +1,94 @@
+#ifndef __ENSEMBLE_CODEC_HPP__
+#define __ENSEMBLE_CODEC_HPP__
+/**
+ * @brief Delta encoding of ensemble records
+ *
+ * Each field of a record is encoded as the difference from the same field of
+ * the previous record of the same ensemble type, zigzag mapped and written as
+ * a little-endian base 128 varint, so fields that change little take one
+ * byte.  The elapsed time in the ensemble header is encoded the same way.
+ *
+ * A delta record is
+ *
+ *     type, varint(zigzag(elapsed delta)), varint(zigzag(field delta))...
+ *
+ * Ensemble types without a field layout, and records that would not be
+ * smaller, are stored as
+ *
+ *     ENS_CODEC_RAW, varint(nBytes), record
+ *
+ * and do not change the codec state.
+ *
+ * A reset codec encodes the next record of every type against zero, which is
+ * a keyframe.  The recorder resets its codec at the start of every packet,
+ * so each packet decodes on its own.  Decoding a delta record and writing it
+ * back as a record restores the original bytes exactly.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ensembleTypes.hpp"
+
+/**
+ * @brief Most fields in a delta encoded ensemble
+ *
+ */
+#define ENS_CODEC_MAX_FIELDS    12
+
+/**
+ * @brief Marker of a record stored as is
+ *
+ */
+#define ENS_CODEC_RAW   0x00
+
+/**
+ * @brief Most bytes an encoded record is longer than the record
+ *
+ * The raw marker and a varint length of up to 3 bytes.
+ */
+#define ENS_CODEC_MAX_OVERHEAD  4
+
+/**
+ * @brief Previous record of each ensemble type
+ *
+ */
+typedef struct EnsembleCodec_
+{
+    uint32_t elapsedTime_ds[ENS_NUM_ENSEMBLES];
+    uint32_t fields[ENS_NUM_ENSEMBLES][ENS_CODEC_MAX_FIELDS];
+}EnsembleCodec_t;
+
+/**
+ * @brief Resets a codec, so the next record of every type is a keyframe
+ *
+ * @param pCodec Codec
+ */
+void Ens_resetCodec(EnsembleCodec_t* pCodec);
+
+/**
+ * @brief Encodes one record
+ *
+ * @param pCodec Codec
+ * @param pRecord Record, starting with its ensemble header
+ * @param nBytes Length of the record, at most 65535
+ * @param pOut Buffer to write at most nBytes + ENS_CODEC_MAX_OVERHEAD bytes
+ * into
+ * @return size_t Number of bytes written
+ */
+size_t Ens_encodeRecord(EnsembleCodec_t* pCodec, const uint8_t* pRecord, size_t nBytes, uint8_t* pOut);
+
+/**
+ * @brief Decodes one record
+ *
+ * @param pCodec Codec
+ * @param pIn Encoded records
+ * @param nIn Number of bytes of encoded records
+ * @param pRecord Buffer to write the record into
+ * @param pRecordLen Length of the record buffer, set to the length of the
+ * record
+ * @return int Number of bytes of pIn decoded, 0 if pIn ends within the
+ * record, or -1 if the record is invalid or does not fit pRecord
+ */
+int Ens_decodeRecord(EnsembleCodec_t* pCodec, const uint8_t* pIn, size_t nIn, uint8_t* pRecord, size_t* pRecordLen);
+
+#endif
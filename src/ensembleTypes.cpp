@@ -3,4 +3,14 @@
 unsigned int Ens_getStartTime(system_tick_t sessionStart)
 {
     return ((millis() - sessionStart) / 100) & 0x00FFFFFF;
-}
\ No newline at end of file
+}
+
+uint8_t* Ens_putHeader(void* pBuffer, EnsembleID_e type, system_tick_t sessionStart)
+{
+    EnsembleHeader_t header;
+
+    header.ensembleType = type;
+    header.elapsedTime_ds = Ens_getStartTime(sessionStart);
+    memcpy(pBuffer, &header, sizeof(EnsembleHeader_t));
+    return (uint8_t*) pBuffer + sizeof(EnsembleHeader_t);
+}
@@ -15,6 +15,7 @@ typedef enum EnsembleID_
     ENS_IMU,
     ENS_TEMP_IMU,
     ENS_TEMP_IMU_GPS,
+    ENS_STORAGE,
     ENS_TEXT = 0x0F,
     ENS_NUM_ENSEMBLES
 }EnsembleID_e;
@@ -61,7 +62,52 @@ typedef struct Ensemble11_data_
     int16_t rawMagField[3];
     int32_t location[2];
 }Ensemble11_data_t;
+
+/**
+ * @brief Ensemble 12 - Storage forecast
+ * 
+ */
+typedef struct Ensemble12_data_
+{
+    /**
+     * @brief Free file system space (kB)
+     * 
+     */
+    uint16_t freeSpace_kB;
+    /**
+     * @brief File system used per minute of riding, after compression
+     * (bytes)
+     * 
+     */
+    uint16_t bytesPerMinute;
+    /**
+     * @brief Minutes of riding until the file system is full, 0xFFFF if more
+     * 
+     */
+    uint16_t minutesRemaining;
+    /**
+     * @brief Share of the session that is packet padding (%)
+     * 
+     */
+    uint8_t paddingPercent;
+    /**
+     * @brief 1 if the rate was measured over the ride, 0 if estimated from the
+     * schedule
+     * 
+     */
+    uint8_t measured;
+}Ensemble12_data_t;
 #pragma pack(pop)
 
 unsigned int Ens_getStartTime(system_tick_t sessionStart);
+
+/**
+ * @brief Writes an ensemble header
+ * 
+ * @param pBuffer Buffer to write sizeof(EnsembleHeader_t) bytes into
+ * @param type Ensemble type
+ * @param sessionStart Session start time
+ * @return uint8_t* First byte after the header
+ */
+uint8_t* Ens_putHeader(void* pBuffer, EnsembleID_e type, system_tick_t sessionStart);
 #endif
\ No newline at end of file
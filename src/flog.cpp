@@ -53,10 +53,19 @@ const FLOG_Message_t FLOG_Message[] = {
     {FLOG_MAG_I2C_FAIL, "Compass I2C Failure"},
     {FLOG_MAG_MODE_FAIL, "Compass Mode Set Fail"},
     {FLOG_RIDE_INIT_TIMEOUT, "Ride init Timeout"},
+    {FLOG_SCH_FIRST_MISS, "Schedule entry first miss"},
+    {FLOG_SCH_STATS_ENTRY, "Schedule entry missed slots"},
+    {FLOG_SCH_MISS_COUNT, "Schedule miss count"},
+    {FLOG_SCH_LATENESS, "Schedule lateness ms"},
+    {FLOG_SCH_DEADLINE_MISS, "Schedule deadline misses"},
     {FLOG_UPLOAD_NO_UPLOAD, "Upload - No Upload Flag set"},
     {FLOG_UPL_BATT_LOW, "Upload Battery low"},
     {FLOG_UPL_FOLDER_COUNT, "Upload file count"},
     {FLOG_UPL_CONNECT_FAIL, "Upload connect fail"},
+    {FLOG_REC_PACKET_DROP, "Recorder packet dropped"},
+    {FLOG_REC_NO_WRITER, "Recorder writer thread failed"},
+    {FLOG_REC_PACKET_CORRUPT, "Recorder packet CRC mismatch"},
+    {FLOG_REC_RECOVERED, "Recorder recovered session"},
     {FLOG_NULL, NULL}
 };
 
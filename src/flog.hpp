@@ -30,10 +30,19 @@ typedef enum FLOG_CODE_
     FLOG_MAG_I2C_FAIL     =0x0305,
     FLOG_MAG_MODE_FAIL    =0x0306,
     FLOG_RIDE_INIT_TIMEOUT=0x0401,
+    FLOG_SCH_FIRST_MISS   =0x0501,
+    FLOG_SCH_STATS_ENTRY  =0x0502,
+    FLOG_SCH_MISS_COUNT   =0x0503,
+    FLOG_SCH_LATENESS     =0x0504,
+    FLOG_SCH_DEADLINE_MISS=0x0505,
     FLOG_UPLOAD_NO_UPLOAD =0x0601,
     FLOG_UPL_BATT_LOW     =0x0602,
     FLOG_UPL_FOLDER_COUNT =0x0603,
     FLOG_UPL_CONNECT_FAIL =0x0604,
+    FLOG_REC_PACKET_DROP  =0x0701,
+    FLOG_REC_NO_WRITER    =0x0702,
+    FLOG_REC_PACKET_CORRUPT=0x0703,
+    FLOG_REC_RECOVERED    =0x0704,
 }FLOG_CODE_e;
 
 void FLOG_Initialize(void);
@@ -0,0 +1,200 @@
+#include "lzss.hpp"
+
+#include <string.h>
+
+#define LZSS_MAX_MATCH  (1 << LZSS_LOOKAHEAD_BITS)
+
+/**
+ * @brief Shortest match worth a back reference
+ *
+ * A back reference is 1 + LZSS_WINDOW_BITS + LZSS_LOOKAHEAD_BITS bits, two
+ * literals are 18.
+ */
+#define LZSS_MIN_MATCH  2
+
+#define LZSS_LITERAL_BITS   9
+#define LZSS_BACKREF_BITS   (1 + LZSS_WINDOW_BITS + LZSS_LOOKAHEAD_BITS)
+
+static void LZSS_putBits(LZSS_Encoder_t* pEncoder, uint32_t value, size_t nBits);
+static int LZSS_getBits(const uint8_t* pIn, size_t nIn, size_t* pBitIdx, size_t nBits, uint32_t* pValue);
+
+void LZSS_initEncoder(LZSS_Encoder_t* pEncoder, uint8_t* pOut, size_t outLen)
+{
+    memset(pOut, 0, outLen);
+    pEncoder->pOut = pOut;
+    pEncoder->outLen = outLen;
+    pEncoder->nBits = 0;
+    pEncoder->inPos = 0;
+}
+
+int LZSS_compress(LZSS_Encoder_t* pEncoder, const uint8_t* pIn, size_t nIn)
+{
+    size_t startBits = pEncoder->nBits;
+    size_t startPos = pEncoder->inPos;
+    size_t pos = pEncoder->inPos;
+    size_t maxBits = pEncoder->outLen * 8;
+    size_t maxLen, bestLen, bestOffset;
+    size_t windowStart;
+    size_t len;
+    size_t i;
+
+    while(pos < nIn)
+    {
+        // longest match in the window, nearest first
+        maxLen = nIn - pos < LZSS_MAX_MATCH ? nIn - pos : LZSS_MAX_MATCH;
+        windowStart = pos > LZSS_MAX_INPUT_LEN ? pos - LZSS_MAX_INPUT_LEN : 0;
+        bestLen = 0;
+        bestOffset = 0;
+        for(i = pos; i > windowStart && bestLen < maxLen; i--)
+        {
+            if(pIn[i - 1] != pIn[pos])
+            {
+                continue;
+            }
+            for(len = 1; len < maxLen && pIn[i - 1 + len] == pIn[pos + len]; len++)
+            {
+            }
+            if(len > bestLen)
+            {
+                bestLen = len;
+                bestOffset = pos - (i - 1);
+            }
+        }
+
+        if(bestLen >= LZSS_MIN_MATCH)
+        {
+            if(pEncoder->nBits + LZSS_BACKREF_BITS > maxBits)
+            {
+                break;
+            }
+            LZSS_putBits(pEncoder, 0, 1);
+            LZSS_putBits(pEncoder, bestOffset - 1, LZSS_WINDOW_BITS);
+            LZSS_putBits(pEncoder, bestLen - 1, LZSS_LOOKAHEAD_BITS);
+            pos += bestLen;
+        }
+        else
+        {
+            if(pEncoder->nBits + LZSS_LITERAL_BITS > maxBits)
+            {
+                break;
+            }
+            LZSS_putBits(pEncoder, 0x100 | pIn[pos], LZSS_LITERAL_BITS);
+            pos++;
+        }
+    }
+
+    if(pos < nIn)
+    {
+        // out of room, clear what this call wrote
+        if(startBits % 8)
+        {
+            pEncoder->pOut[startBits / 8] &= (uint8_t) (0xFF00 >> (startBits % 8));
+        }
+        memset(pEncoder->pOut + (startBits + 7) / 8, 0,
+            (pEncoder->nBits + 7) / 8 - (startBits + 7) / 8);
+        pEncoder->nBits = startBits;
+        pEncoder->inPos = startPos;
+        return 0;
+    }
+    pEncoder->inPos = pos;
+    return 1;
+}
+
+size_t LZSS_getLength(const LZSS_Encoder_t* pEncoder)
+{
+    return (pEncoder->nBits + 7) / 8;
+}
+
+int LZSS_decompress(const uint8_t* pIn, size_t nIn, uint8_t* pOut, size_t outLen)
+{
+    size_t bitIdx = 0;
+    size_t outIdx = 0;
+    uint32_t tag;
+    uint32_t value;
+    uint32_t offset;
+    uint32_t len;
+
+    while(LZSS_getBits(pIn, nIn, &bitIdx, 1, &tag))
+    {
+        if(tag)
+        {
+            if(!LZSS_getBits(pIn, nIn, &bitIdx, 8, &value))
+            {
+                break;
+            }
+            if(outIdx >= outLen)
+            {
+                return -1;
+            }
+            pOut[outIdx++] = (uint8_t) value;
+        }
+        else
+        {
+            if(!LZSS_getBits(pIn, nIn, &bitIdx, LZSS_WINDOW_BITS, &offset) ||
+                !LZSS_getBits(pIn, nIn, &bitIdx, LZSS_LOOKAHEAD_BITS, &len))
+            {
+                break;
+            }
+            offset++;
+            len++;
+            if(offset > outIdx || len > outLen - outIdx)
+            {
+                return -1;
+            }
+            // the source may overlap the bytes being copied
+            for(; len > 0; len--, outIdx++)
+            {
+                pOut[outIdx] = pOut[outIdx - offset];
+            }
+        }
+    }
+    return outIdx;
+}
+
+/**
+ * @brief Appends bits to the output, most significant first
+ *
+ * The caller checks that the bits fit.
+ *
+ * @param pEncoder Encoder
+ * @param value Bits, right aligned
+ * @param nBits Number of bits
+ */
+static void LZSS_putBits(LZSS_Encoder_t* pEncoder, uint32_t value, size_t nBits)
+{
+    while(nBits > 0)
+    {
+        nBits--;
+        if((value >> nBits) & 1)
+        {
+            pEncoder->pOut[pEncoder->nBits / 8] |= (uint8_t) (0x80 >> (pEncoder->nBits % 8));
+        }
+        pEncoder->nBits++;
+    }
+}
+
+/**
+ * @brief Reads bits from the input, most significant first
+ *
+ * @param pIn Input
+ * @param nIn Length of the input
+ * @param pBitIdx Index of the next bit, advanced past the bits read
+ * @param nBits Number of bits
+ * @param pValue Bits read, right aligned
+ * @return int 1 if successful, 0 if the input ends first
+ */
+static int LZSS_getBits(const uint8_t* pIn, size_t nIn, size_t* pBitIdx, size_t nBits, uint32_t* pValue)
+{
+    uint32_t value = 0;
+
+    if(*pBitIdx + nBits > nIn * 8)
+    {
+        return 0;
+    }
+    for(; nBits > 0; nBits--, (*pBitIdx)++)
+    {
+        value = (value << 1) | ((pIn[*pBitIdx / 8] >> (7 - *pBitIdx % 8)) & 1);
+    }
+    *pValue = value;
+    return 1;
+}
@@ -0,0 +1,98 @@
+#ifndef __LZSS_HPP__
+#define __LZSS_HPP__
+/**
+ * @brief LZSS block compressor for packets
+ *
+ * The bit stream is the heatshrink format with a window of
+ * 2^LZSS_WINDOW_BITS bytes and a lookahead of 2^LZSS_LOOKAHEAD_BITS bytes,
+ * most significant bit first:
+ *
+ *  - 1, byte: literal byte
+ *  - 0, offset - 1 (LZSS_WINDOW_BITS), length - 1 (LZSS_LOOKAHEAD_BITS):
+ *    copy length bytes starting offset bytes back
+ *
+ * The last byte is zero padded, which is too short for another token.
+ *
+ * Compression needs no RAM beyond the input and output buffers.  The whole
+ * input is the window, so inputs are limited to LZSS_MAX_INPUT_LEN bytes.
+ * The encoder is streaming: each call encodes the input added since the
+ * previous call, and fails without changing anything if the output does not
+ * fit.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#define LZSS_WINDOW_BITS    10
+#define LZSS_LOOKAHEAD_BITS 4
+
+/**
+ * @brief Longest input to compress
+ *
+ */
+#define LZSS_MAX_INPUT_LEN  (1 << LZSS_WINDOW_BITS)
+
+/**
+ * @brief Encoder state
+ *
+ */
+typedef struct LZSS_Encoder_
+{
+    uint8_t* pOut;
+    size_t outLen;
+    /**
+     * @brief Number of bits written to pOut
+     *
+     */
+    size_t nBits;
+    /**
+     * @brief Number of input bytes encoded
+     *
+     */
+    size_t inPos;
+}LZSS_Encoder_t;
+
+/**
+ * @brief Starts a new compressed block
+ *
+ * @param pEncoder Encoder
+ * @param pOut Output buffer, zeroed here
+ * @param outLen Length of the output buffer
+ */
+void LZSS_initEncoder(LZSS_Encoder_t* pEncoder, uint8_t* pOut, size_t outLen);
+
+/**
+ * @brief Encodes the input added since the last call
+ *
+ * Matches do not extend past nIn, so the output is complete after every
+ * call.
+ *
+ * @param pEncoder Encoder
+ * @param pIn Input, the same buffer every call with data only added at the
+ * end
+ * @param nIn Number of bytes of input, at most LZSS_MAX_INPUT_LEN
+ * @return int 1 if successful, 0 if the output buffer is full, in which case
+ * the encoder and output are unchanged
+ */
+int LZSS_compress(LZSS_Encoder_t* pEncoder, const uint8_t* pIn, size_t nIn);
+
+/**
+ * @brief Returns the number of bytes of output
+ *
+ * @param pEncoder Encoder
+ * @return size_t Number of bytes written to the output buffer
+ */
+size_t LZSS_getLength(const LZSS_Encoder_t* pEncoder);
+
+/**
+ * @brief Decompresses a block
+ *
+ * @param pIn Compressed block
+ * @param nIn Length of the compressed block
+ * @param pOut Buffer to decompress into
+ * @param outLen Length of the output buffer
+ * @return int Number of bytes decompressed, or -1 if the block is invalid or
+ * does not fit pOut
+ */
+int LZSS_decompress(const uint8_t* pIn, size_t nIn, uint8_t* pOut, size_t outLen);
+
+#endif
@@ -18,6 +18,10 @@ class NVRAM
         TMP116_CAL_CYCLE_PERIOD_SEC,
         UPLOAD_REATTEMPTS,
         NO_UPLOAD_FLAG,
+        UPLOAD_CURSOR_NAME,
+        UPLOAD_CURSOR_LENGTH,
+        SESSION_ID,
+        SESSION_NAME,
         NUM_DATA_IDs
     }DATA_ID_e;
 
@@ -39,7 +43,11 @@ class NVRAM
         {TMP116_CAL_DATA_COLLECTION_PERIOD_SEC, 0x0008, sizeof(uint32_t)},
         {TMP116_CAL_CYCLE_PERIOD_SEC, 0x000C, sizeof(uint32_t)},
         {UPLOAD_REATTEMPTS, 0x0014, sizeof(uint8_t)},
-        {NO_UPLOAD_FLAG, 0x0015, sizeof(uint8_t)}
+        {NO_UPLOAD_FLAG, 0x0015, sizeof(uint8_t)},
+        {UPLOAD_CURSOR_NAME, 0x0018, 32 * sizeof(char)},
+        {UPLOAD_CURSOR_LENGTH, 0x0038, sizeof(uint32_t)},
+        {SESSION_ID, 0x003C, sizeof(uint32_t)},
+        {SESSION_NAME, 0x0040, 32 * sizeof(char)}
 
     };
     static NVRAM& getInstance(void);
@@ -59,6 +59,14 @@
  */
 #define SF_FLASH_SIZE_MB    4
 
+/**
+ * @brief Time without flash accesses before the flash enters deep power down,
+ * in ms
+ * 
+ * The next access wakes it, which takes tens of microseconds.
+ */
+#define SF_FLASH_POWER_DOWN_IDLE_MS 250
+
 /**
  * Charging voltage (mV)
  */
@@ -171,6 +179,63 @@
  */
 #define SF_UPLOAD_REATTEMPT_DELAY_SEC 600
 
+/**
+ * @brief Wake-up latency of a short delay() in ms
+ * 
+ */
+#define SF_IDLE_DELAY_WAKE_LATENCY_MS   1
+
+/**
+ * @brief Longest single delay() idle step in ms
+ * 
+ * Serial5 buffers 64 bytes, which the GPS fills in about 66 ms at 9600 baud.
+ */
+#define SF_IDLE_DELAY_MAX_MS    50
+
+/**
+ * @brief Initial wake-up latency estimate of an ULTRA_LOW_POWER sleep in ms
+ * 
+ * The scheduler refines this with the observed oversleep.
+ */
+#define SF_IDLE_SLEEP_WAKE_LATENCY_MS   5
+
+/**
+ * @brief Shortest ULTRA_LOW_POWER sleep worth entering in ms
+ * 
+ */
+#define SF_IDLE_SLEEP_MIN_MS    20
+
+/**
+ * @brief Ensembles due within this many ms share one sensor snapshot
+ * 
+ */
+#define SF_SENSOR_SNAPSHOT_WINDOW_MS    100
+
+/**
+ * @brief IMU sample interval during a ride in ms
+ * 
+ */
+#define SF_IMU_SAMPLE_INTERVAL_MS   20
+
+/**
+ * @brief Number of IMU samples averaged into each 1 Hz ride ensemble
+ * 
+ * SF_IMU_SAMPLE_INTERVAL_MS * SF_IMU_SAMPLES_PER_ENSEMBLE must be 1000.
+ */
+#define SF_IMU_SAMPLES_PER_ENSEMBLE 50
+
+/**
+ * @brief Time after each scheduled IMU sample by which it must be taken in ms
+ * 
+ */
+#define SF_IMU_SAMPLE_DEADLINE_MS   10
+
+/**
+ * @brief Interval between storage forecasts recorded during a ride in ms
+ * 
+ */
+#define SF_STORAGE_FORECAST_INTERVAL_MS (5 * 60 * 1000)
+
 /**
  * @brief how many ms is a GPS data point valid for a given data log
  * 
@@ -232,4 +297,86 @@
 
 #define SF_UPLOAD_ENCODING SF_UPLOAD_BASE64URL
 
+/**
+ * @brief Records that do not fit the rest of a packet continue in the next
+ * packet instead of leaving the rest of the packet as padding
+ * 
+ */
+#define SF_REC_SPLIT_RECORDS    1
+
+/**
+ * @brief Records are delta encoded against the previous record of the same
+ * ensemble type, see ensembleCodec.hpp
+ * 
+ */
+#define SF_REC_DELTA_ENCODING   1
+
+/**
+ * @brief Packets are LZSS compressed when that makes them smaller, see
+ * lzss.hpp
+ * 
+ */
+#define SF_REC_COMPRESSION  1
+
+/**
+ * @brief Flush the session after every packet
+ * 
+ */
+#define SF_REC_FLUSH_PER_PACKET 1
+/**
+ * @brief Flush the session every SF_REC_FLUSH_PACKETS packets, or when a
+ * packet is written SF_REC_FLUSH_INTERVAL_MS or more after the first
+ * unflushed packet
+ * 
+ */
+#define SF_REC_FLUSH_PERIODIC   2
+/**
+ * @brief Flush the session only when it is closed
+ * 
+ */
+#define SF_REC_FLUSH_ON_CLOSE   3
+
+/**
+ * @brief When the recorder commits session writes to flash
+ * 
+ * Packets written but not flushed sit in the file system's write cache and
+ * are lost on a reset.  Flushing less often saves page programs and write
+ * latency.  Whatever is flushed is recovered on the next boot.
+ * 
+ */
+#define SF_REC_FLUSH_MODE   SF_REC_FLUSH_PERIODIC
+#define SF_REC_FLUSH_PACKETS    4
+#define SF_REC_FLUSH_INTERVAL_MS    60000
+
+/**
+ * @brief Longest ride the recorder erases flash for before it starts, in
+ * minutes
+ * 
+ * Room for the ride's records, at the schedule's rate after encoding and
+ * compression, is erased while the device idles on the charger, in the CLI
+ * or after an upload, and what is still missing when the session opens, for
+ * up to SF_REC_PREALLOCATE_MAX_MS.  240 minutes of the ride schedule take
+ * about 240 kB, a quarter of the file system.  Set to 0 to leave garbage
+ * collection to SPIFFS during the ride.
+ * 
+ */
+#define SF_REC_PREALLOCATE_MIN  240
+
+/**
+ * @brief Longest time spent erasing flash when a session opens, in ms
+ * 
+ * What is not erased by then is left to SPIFFS during the ride.
+ * 
+ */
+#define SF_REC_PREALLOCATE_MAX_MS   2000
+
+/**
+ * @brief Longest time spent erasing flash for the next ride after an upload,
+ * in ms
+ * 
+ * The charge and CLI states erase for as long as they run.
+ * 
+ */
+#define SF_UPLOAD_ERASE_AHEAD_MS    30000
+
 #endif
\ No newline at end of file
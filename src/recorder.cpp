@@ -3,352 +3,1053 @@
 #include "system.hpp"
 #include "deploy.hpp"
 #include "conio.hpp"
+#include "flog.hpp"
+#include "crc32.hpp"
+#include "lzss.hpp"
+#include "utils.hpp"
 
 #define REC_DEBUG
-static int REC_getNumFiles(void);
+static void REC_writerThread(void* pArgs);
+
+static_assert((REC_PACKET_QUEUE_LEN & (REC_PACKET_QUEUE_LEN - 1)) == 0,
+    "REC_PACKET_QUEUE_LEN must be a power of two");
+static_assert(REC_PACKET_QUEUE_LEN >= 2,
+    "REC_PACKET_QUEUE_LEN must allow a packet to be queued");
+static_assert(SPIFFS_OBJ_NAME_LEN == 32,
+    "NVRAM::UPLOAD_CURSOR_NAME must hold a SPIFFS file name");
+
+/**
+ * @brief Name of the session being recorded
+ * 
+ */
+#define REC_TEMP_SESSION    "__temp"
+
+/**
+ * @brief Free space reserved past the expected session length, in bytes
+ * 
+ * SPIFFS collects garbage whenever 3 or fewer blocks are free, so 4 more
+ * blocks of the Smartfin flash keep the end of the session clear of it.
+ * 
+ */
+#define REC_PREALLOCATE_MARGIN  (4 * 4096)
+
+/**
+ * @brief Most garbage collection passes made for a session
+ * 
+ * Each pass erases up to SPIFFS_GC_MAX_RUNS blocks, so this covers the whole
+ * file system.
+ * 
+ */
+#define REC_PREALLOCATE_MAX_GC  64
+
+/**
+ * @brief Flags of every packet of a session
+ * 
+ */
+#if SF_REC_DELTA_ENCODING
+#define REC_PACKET_FLAGS    REC_PACKET_FLAG_DELTA
+#else
+#define REC_PACKET_FLAGS    0
+#endif
+
+/**
+ * @brief Session index file header
+ * 
+ */
+typedef struct REC_SessionIndexHeader_
+{
+    uint32_t magic;
+    uint32_t nSessions;
+}REC_SessionIndexHeader_t;
+
+/**
+ * @brief Sessions waiting for upload, oldest first
+ * 
+ * Kept in RAM and written to REC_SESSION_INDEX_FILE whenever a session is
+ * added or removed, so finding the next packet to upload never scans the
+ * directory.  Upload cursors are written to the index file only with those
+ * changes, NVRAM holds the current cursor.
+ */
+static REC_SessionEntry_t REC_sessionIndex[REC_SESSION_INDEX_LEN];
+static uint32_t REC_nSessions = 0;
+static uint8_t REC_sessionIndexOverflow = 0;
+
+/**
+ * @brief Given for each sealed packet, the writer thread waits on it
+ * 
+ */
+static os_semaphore_t REC_writerSignal;
+
+static int REC_isSession(const char* pName);
+static int REC_findSession(const char* pName);
+static int REC_rebuildIndex(void);
+static int REC_saveIndex(void);
+static int REC_loadIndex(void);
+static int REC_countSessions(void);
+static void REC_addSession(const char* pName, uint32_t length);
+static void REC_removeSession(uint32_t idx);
+static size_t REC_getUploadEnd(const char* pName, size_t fileLength);
+static uint32_t REC_packetCRC(const uint8_t* pPacket, size_t nBytes);
+static int REC_checkPacket(const uint8_t* pPacket, size_t nBytes, uint16_t* pSequence);
+static int REC_repairPacket(uint8_t* pPacket, size_t nBytes);
+static int REC_isValidName(const char* pName);
+static void REC_preallocate(size_t nBytes);
+static void REC_setUploadEnd(const char* pName, size_t uploadEnd);
+static void REC_clearUploadCursor(const char* pName);
 
 /**
- * @brief Initializes the Recorder to an idle state
+ * @brief Initializes the Recorder to an idle state, loads the session index,
+ * recovers an interrupted session and starts the writer thread
+ * 
+ * The stored session index is checked against the number of sessions in the
+ * directory, and rebuilt if they differ.  If the writer thread cannot be
+ * started, sealed packets are written as they are sealed instead.
  * 
  * @return int 1 if successful, otherwise 0
  */
 int Recorder::init(void)
 {
     memset(this->lastSessionName, 0, REC_SESSION_NAME_MAX_LEN + 1);
+    this->lastPacketStart = 0;
+    if (!REC_loadIndex() || (int) REC_nSessions != REC_countSessions())
+    {
+        SF_OSAL_printf("Rebuilding session index\n");
+        REC_rebuildIndex();
+    }
+    this->recoverSession();
+    memset(&this->queueStats, 0, sizeof(REC_QueueStats_t));
+    this->isRecording = 0;
+    this->queueHead.store(0);
+    this->queueTail.store(0);
+    this->pDataBuffer = this->packetQueue[0];
+    this->dataIdx = sizeof(REC_PacketHeader_t);
+    this->pendingBytes = 0;
+    this->packetFlags = REC_PACKET_FLAGS;
+    this->hasWriterThread = (0 == os_semaphore_create(&REC_writerSignal, 1, 0) &&
+        0 == os_thread_create(&this->writerThread, "recorder", OS_THREAD_PRIORITY_DEFAULT,
+            REC_writerThread, this, OS_THREAD_STACK_SIZE_DEFAULT));
+    if(!this->hasWriterThread)
+    {
+        FLOG_AddError(FLOG_REC_NO_WRITER, 0);
+    }
     return 1;
 }
 
+/**
+ * @brief Writes sealed packets to flash as they are queued
+ * 
+ * Sleeps on REC_writerSignal between packets, so the thread costs nothing
+ * while the device is not recording.
+ * 
+ * @param pArgs Recorder
+ */
+static void REC_writerThread(void* pArgs)
+{
+    Recorder* pRecorder = (Recorder*) pArgs;
+
+    while(1)
+    {
+        os_semaphore_take(REC_writerSignal, CONCURRENT_WAIT_FOREVER, false);
+        pRecorder->writeQueuedPackets();
+    }
+}
+
 /**
  * @brief Checks if the Recorder has data to upload
  * 
  * @return int  1 if data exists, otherwise 0
  */
 int Recorder::hasData(void)
+{
+    return REC_nSessions > 0;
+}
+
+/**
+ * @brief Returns the number of sessions waiting for upload
+ * 
+ * @return int Number of sessions in the session index
+ */
+int Recorder::getNumFiles(void)
+{
+    return REC_nSessions;
+}
+
+/**
+ * @brief Checks if a file is a session to upload
+ * 
+ * Calibration sessions, the temporary session and the session index itself
+ * start with '.' or '_' and are never uploaded.
+ * 
+ * @param pName File name
+ * @return int 1 if the file is a session, otherwise 0
+ */
+static int REC_isSession(const char* pName)
+{
+    return pName[0] != '.' && pName[0] != '_' && pName[0] != 0;
+}
+
+/**
+ * @brief Finds a session in the index
+ * 
+ * @param pName Session name
+ * @return int Index entry, or -1 if not found
+ */
+static int REC_findSession(const char* pName)
+{
+    uint32_t i;
+
+    for (i = 0; i < REC_nSessions; i++)
+    {
+        if (0 == strncmp(REC_sessionIndex[i].name, pName, SPIFFS_OBJ_NAME_LEN))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Rebuilds the session index from the directory
+ * 
+ * The only directory scan, done when the stored index is missing or does
+ * not match the directory.
+ * 
+ * @return int 1 if successful, otherwise 0
+ */
+static int REC_rebuildIndex(void)
 {
     spiffs_DIR dir;
     spiffs_dirent dirEntry;
+
+    REC_nSessions = 0;
+    REC_sessionIndexOverflow = 0;
     if (!pSystemDesc->pFileSystem->opendir("", &dir))
     {
+        SF_OSAL_printf("Failed to open directory\n");
         return 0;
     }
     while (pSystemDesc->pFileSystem->readdir(&dir, &dirEntry))
     {
-        if(dirEntry.name[0] != '.' && dirEntry.name[0] != '_')
+        if (!REC_isSession((const char*) dirEntry.name))
+        {
+            continue;
+        }
+        if (REC_nSessions == REC_SESSION_INDEX_LEN)
         {
-            pSystemDesc->pFileSystem->closedir(&dir);
-            return 1;
+            REC_sessionIndexOverflow = 1;
+            break;
         }
+        memset(&REC_sessionIndex[REC_nSessions], 0, sizeof(REC_SessionEntry_t));
+        strncpy(REC_sessionIndex[REC_nSessions].name, (const char*) dirEntry.name, 
+            SPIFFS_OBJ_NAME_LEN - 1);
+        REC_sessionIndex[REC_nSessions].length = dirEntry.size;
+        REC_sessionIndex[REC_nSessions].uploadEnd = dirEntry.size;
+        REC_nSessions++;
     }
     pSystemDesc->pFileSystem->closedir(&dir);
-    return 0;
+    return REC_saveIndex();
 }
 
-int Recorder::getNumFiles(void)
+/**
+ * @brief Writes the session index to flash
+ * 
+ * @return int 1 if successful, otherwise 0
+ */
+static int REC_saveIndex(void)
 {
-    return REC_getNumFiles();
+    SpiffsParticleFile indexFile;
+    REC_SessionIndexHeader_t header;
+    size_t indexLen = REC_nSessions * sizeof(REC_SessionEntry_t);
+    int success;
+
+    header.magic = REC_SESSION_INDEX_MAGIC;
+    header.nSessions = REC_nSessions;
+    indexFile = pSystemDesc->pFileSystem->openFile(REC_SESSION_INDEX_FILE, 
+        SPIFFS_O_WRONLY | SPIFFS_O_CREAT | SPIFFS_O_TRUNC);
+    if (!indexFile.isValid())
+    {
+        return 0;
+    }
+    success = indexFile.write((const uint8_t*) &header, sizeof(header)) == sizeof(header) && 
+        indexFile.write((const uint8_t*) REC_sessionIndex, indexLen) == indexLen;
+    indexFile.flush();
+    indexFile.close();
+    return success;
 }
-#define REC_DIR_TREE_SIZE 16
 
-typedef struct REC_dirTree_
+/**
+ * @brief Reads the session index from flash
+ * 
+ * @return int 1 if a valid index was read, otherwise 0
+ */
+static int REC_loadIndex(void)
 {
-    char filename[SPIFFS_OBJ_NAME_LEN];
-    uint8_t initialized;
-} REC_dirTree_t;
+    SpiffsParticleFile indexFile;
+    REC_SessionIndexHeader_t header;
+    size_t indexLen;
+    int success = 0;
 
-static REC_dirTree_t REC_dirTree[REC_DIR_TREE_SIZE];
-static uint8_t REC_dirTreeInitialized = 0;
-static int REC_dirTreeSkipped = 0;
+    indexFile = pSystemDesc->pFileSystem->openFile(REC_SESSION_INDEX_FILE, SPIFFS_O_RDONLY);
+    if (!indexFile.isValid())
+    {
+        return 0;
+    }
+    if (indexFile.readBytes((char*) &header, sizeof(header)) == sizeof(header) &&
+        header.magic == REC_SESSION_INDEX_MAGIC && 
+        header.nSessions <= REC_SESSION_INDEX_LEN &&
+        (size_t) indexFile.length() == sizeof(header) + header.nSessions * sizeof(REC_SessionEntry_t))
+    {
+        indexLen = header.nSessions * sizeof(REC_SessionEntry_t);
+        if (indexFile.readBytes((char*) REC_sessionIndex, indexLen) == indexLen)
+        {
+            REC_nSessions = header.nSessions;
+            success = 1;
+        }
+    }
+    indexFile.close();
+    return success;
+}
 
-static int REC_getNumFiles(void)
+/**
+ * @brief Counts the sessions in the directory
+ * 
+ * @return int Number of sessions, or -1 if the directory cannot be read
+ */
+static int REC_countSessions(void)
 {
     spiffs_DIR dir;
     spiffs_dirent dirEntry;
-    int i = 0;
+    int nSessions = 0;
 
     if (!pSystemDesc->pFileSystem->opendir("", &dir))
     {
         return -1;
     }
-
     while (pSystemDesc->pFileSystem->readdir(&dir, &dirEntry))
     {
-        i++;
+        nSessions += REC_isSession((const char*) dirEntry.name);
     }
     pSystemDesc->pFileSystem->closedir(&dir);
-    return i;
+    return nSessions;
 }
 
-// static int REC_treeGetNumFiles(void)
-// {
-//     int i = 0;
-//     int numFiles = 0;
-//     for (i = 0; i < REC_DIR_TREE_SIZE; i++)
-//     {
-//         numFiles += (REC_dirTree[i].initialized != 0);
-//     }
-//     return numFiles;
-// }
-
-static int REC_initializeTree(void)
+/**
+ * @brief Adds a session to the end of the index, or updates it if present
+ * 
+ * @param pName Session name
+ * @param length Session length
+ */
+static void REC_addSession(const char* pName, uint32_t length)
 {
-    int nFiles = REC_getNumFiles();
-    int skipFiles = 0;
-    spiffs_DIR dir;
-    spiffs_dirent dirEntry;
-    int i = 0;
-
-    memset(REC_dirTree, 0, sizeof(REC_dirTree_t) * REC_DIR_TREE_SIZE);
+    int idx;
 
-    if (nFiles > REC_DIR_TREE_SIZE)
+    if (!REC_isSession(pName))
     {
-        skipFiles = nFiles - REC_DIR_TREE_SIZE;
-        REC_dirTreeSkipped = 1;
-    }
-
-    if (!pSystemDesc->pFileSystem->opendir("", &dir))
-    {
-        SF_OSAL_printf("Failed to open directory\n");
-        return 1;
+        return;
     }
-    for (i = 0; i < skipFiles; i++)
+    idx = REC_findSession(pName);
+    if (idx < 0)
     {
-        if (!pSystemDesc->pFileSystem->readdir(&dir, &dirEntry))
+        if (REC_nSessions == REC_SESSION_INDEX_LEN)
         {
-            SF_OSAL_printf("Failed to skip initial files\n");
-            return 1;
+            REC_sessionIndexOverflow = 1;
+            return;
         }
+        idx = REC_nSessions++;
+        memset(&REC_sessionIndex[idx], 0, sizeof(REC_SessionEntry_t));
+        strncpy(REC_sessionIndex[idx].name, pName, SPIFFS_OBJ_NAME_LEN - 1);
     }
-
-    for (i = 0; pSystemDesc->pFileSystem->readdir(&dir, &dirEntry) && i < 
-        REC_DIR_TREE_SIZE; i++)
-    {
-        strcpy(REC_dirTree[i].filename, (char *)dirEntry.name);
-        REC_dirTree[i].initialized = 1;
-    }
-    pSystemDesc->pFileSystem->closedir(&dir);
-    REC_dirTreeInitialized = 1;
-    SF_OSAL_printf("Tree Initialized\n");
-    return 0;
+    REC_sessionIndex[idx].length = length;
+    REC_sessionIndex[idx].uploadEnd = length;
+    REC_saveIndex();
 }
 
-int Recorder::openLastSession(Deployment &session, char* pName)
+/**
+ * @brief Removes a session from the index
+ * 
+ * If sessions were left out of a full index, the index is rebuilt so that
+ * they take the freed entry.
+ * 
+ * @param idx Index entry
+ */
+static void REC_removeSession(uint32_t idx)
 {
-    int fileIdx;
-
-    if (REC_initializeTree())
+    if (idx >= REC_nSessions)
     {
-        SF_OSAL_printf("Failed to initialize tree\n");
-        return 1;
+        return;
+    }
+    memmove(&REC_sessionIndex[idx], &REC_sessionIndex[idx + 1], 
+        (REC_nSessions - idx - 1) * sizeof(REC_SessionEntry_t));
+    REC_nSessions--;
+    if (REC_sessionIndexOverflow)
+    {
+        REC_rebuildIndex();
     }
-    for(int i = 0; i < REC_DIR_TREE_SIZE; i++)
+    else
     {
-        SF_OSAL_printf("%d: %32s %d\n", i, REC_dirTree[i].filename, 
-            REC_dirTree[i].initialized);
+        REC_saveIndex();
     }
+}
+
+/**
+ * @brief Reloads the session index from the directory
+ * 
+ * For tools that create or remove files outside the Recorder.
+ * 
+ * @return int 1 if successful, otherwise 0
+ */
+int Recorder::rebuildIndex(void)
+{
+    return REC_rebuildIndex();
+}
+
+/**
+ * @brief Finds the newest session with data left to upload and opens it
+ * 
+ * Sessions that are fully uploaded or missing are dropped from the index.
+ * 
+ * @param session Deployment to open the session in
+ * @return int Index entry of the session, or -1 if there is none
+ */
+int Recorder::openLastSession(Deployment &session)
+{
+    REC_SessionEntry_t* pEntry;
 
-    fileIdx = REC_DIR_TREE_SIZE - 1;
-    do
+    while (REC_nSessions > 0)
     {
-        if (REC_dirTree[fileIdx].initialized && REC_dirTree[fileIdx].filename[0] != '.')
+        pEntry = &REC_sessionIndex[REC_nSessions - 1];
+        pEntry->uploadEnd = REC_getUploadEnd(pEntry->name, pEntry->uploadEnd);
+        if (!session.open(pEntry->name, Deployment::RDWR))
         {
-            SF_OSAL_printf("Trying to open %d %32s %d\n", fileIdx, REC_dirTree[fileIdx].filename, REC_dirTree[fileIdx].initialized);
-            if (!session.open(REC_dirTree[fileIdx].filename, Deployment::RDWR))
-            {
-#ifdef REC_DEBUG
-                SF_OSAL_printf("REC::GLP open %s fail\n", REC_dirTree[fileIdx].filename);
-#endif
-                return 1;
-            }
-            else
-            {
 #ifdef REC_DEBUG
-                SF_OSAL_printf("REC::GLP open %s success\n", REC_dirTree[fileIdx].filename);
-                SF_OSAL_printf("Length: %d\n", session.getLength());
-
+            SF_OSAL_printf("REC::GLP open %s fail\n", pEntry->name);
 #endif
-            }
-
-            if (session.getLength() == 0)
-            {
-                SF_OSAL_printf("No bytes, removing\n");
-                session.remove();
-                REC_dirTree[fileIdx].initialized = 0;
-                session.close();
-            }
-            else
-            {
-                strcpy(pName, REC_dirTree[fileIdx].filename);
-                return 0;
-            }
+            REC_removeSession(REC_nSessions - 1);
+            continue;
+        }
+        if (pEntry->uploadEnd == 0)
+        {
+            SF_OSAL_printf("No bytes, removing\n");
+            session.remove();
+            REC_clearUploadCursor(pEntry->name);
+            REC_removeSession(REC_nSessions - 1);
+            continue;
         }
-    }while(fileIdx-- > 0);
+        return REC_nSessions - 1;
+    }
 
     SF_OSAL_printf("Failed to find session\n");
-    return 1;
+    return -1;
 }
 
 /**
- * @brief Retrieves the last packet of data into pBuffer, and puts the session
- *  name into pName.
+ * @brief Retrieves the last packet not yet uploaded into pBuffer, and puts
+ *  the packet name into pName.
+ * 
+ * Packets whose CRC does not match are skipped.  Packets recorded before
+ * packets had headers are returned whole.
  * 
  * @param pBuffer Buffer to place last packet into
- * @param bufferLen Length of packet buffer
- * @param pName Buffer to place session name into
+ * @param bufferLen Length of packet buffer, at least REC_MAX_PACKET_SIZE
+ * @param pName Buffer to place packet name into
  * @param nameLen Length of name buffer
  * @return int -1 on failure, number of bytes placed into data buffer otherwise
  */
 int Recorder::getLastPacket(void *pBuffer, size_t bufferLen, char *pName, size_t nameLen)
 {
     Deployment &session = Deployment::getInstance();
-    int newLength;
+    REC_SessionEntry_t* pEntry;
+    int idx;
+    size_t packetStart;
     int bytesRead;
-    char name[SPIFFS_OBJ_NAME_LEN];
+    int packetLen;
+    uint16_t sequence;
 
-    if (this->openLastSession(session, name))
+    if (bufferLen < REC_MAX_PACKET_SIZE)
     {
-        memset(this->currentSessionName, 0, REC_SESSION_NAME_MAX_LEN + 1);
         return -1;
     }
+    while (1)
+    {
+        idx = this->openLastSession(session);
+        if (idx < 0)
+        {
+            memset(this->currentSessionName, 0, REC_SESSION_NAME_MAX_LEN + 1);
+            return -1;
+        }
+        pEntry = &REC_sessionIndex[idx];
+
+        // the last packet of a session is not padded
+        packetStart = (pEntry->uploadEnd - 1) / REC_MAX_PACKET_SIZE * REC_MAX_PACKET_SIZE;
+        session.seek(packetStart);
+        bytesRead = session.read(pBuffer, pEntry->uploadEnd - packetStart);
+        session.close();
+        strcpy(this->lastSessionName, pEntry->name);
+        this->lastPacketStart = packetStart;
 
-    newLength = session.getLength() - bufferLen;
-    session.seek(newLength);
-    bytesRead = session.read(pBuffer, bufferLen);
+        sequence = packetStart / REC_MAX_PACKET_SIZE;
+        packetLen = REC_checkPacket((const uint8_t*) pBuffer, bytesRead, &sequence);
+        if (packetLen >= 0)
+        {
+            break;
+        }
+        this->queueStats.corruptPackets++;
+        FLOG_AddError(FLOG_REC_PACKET_CORRUPT, sequence);
+        if (!this->popLastPacket())
+        {
+            return -1;
+        }
+    }
     snprintf((char *)pName, nameLen, "Sfin-%s-%s-%d", pSystemDesc->deviceID,
-             name, newLength / REC_MAX_PACKET_SIZE);
-    session.close();
-    strcpy(this->lastSessionName, name);
-    return bytesRead;
+             pEntry->name, sequence);
+    return packetLen;
 }
 
 /**
- * @brief Trims the last block with specified length from the recorder
+ * @brief Marks the packet last retrieved by getLastPacket as uploaded
+ * 
+ * The session is not truncated.  Only the upload cursor in NVRAM moves,
+ * saving the progress of the session it held to the index if it changes
+ * session, and the session is removed once all of it has been uploaded.
  * 
- * @param len Length of block to trim
  * @return int 1 if successful, otherwise 0
  */
-int Recorder::popLastPacket(size_t len)
+int Recorder::popLastPacket(void)
 {
-    // spiffs_DIR dir;
-    // spiffs_dirent dirEntry;
-    // int i = 0;
     Deployment &session = Deployment::getInstance();
-    int newLength;
+    REC_SessionEntry_t* pEntry;
+    int idx;
 
-    // have last file in dirEntry
-    if (!session.open(this->lastSessionName, Deployment::RDWR))
+    idx = REC_findSession(this->lastSessionName);
+    if (idx < 0)
     {
 #ifdef REC_DEBUG
-        SF_OSAL_printf("REC::TRIM - Fail to open\n");
+        SF_OSAL_printf("REC::TRIM - Not indexed\n");
 #endif
         return 0;
     }
-
-    newLength = session.getLength() - len;
-    if (newLength <= 0)
+    pEntry = &REC_sessionIndex[idx];
+    if (this->lastPacketStart < pEntry->uploadEnd)
     {
-        session.remove();
+        pEntry->uploadEnd = this->lastPacketStart;
     }
-    else
+    if (pEntry->uploadEnd > 0)
     {
-        session.truncate(newLength);
+        REC_setUploadEnd(pEntry->name, pEntry->uploadEnd);
+        return 1;
     }
-    session.close();
 
+    if (!session.open(this->lastSessionName, Deployment::RDWR))
+    {
+#ifdef REC_DEBUG
+        SF_OSAL_printf("REC::TRIM - Fail to open\n");
+#endif
+        return 0;
+    }
+    session.remove();
+    session.close();
+    REC_clearUploadCursor(this->lastSessionName);
+    REC_removeSession(idx);
     return 1;
 }
 
 /**
- * @brief Set the current session name
+ * @brief Computes the CRC of a packet
  * 
- * @param sessionName Current name to set
+ * @param pPacket Packet, starting with its header
+ * @param nBytes Number of bytes of ensembles
+ * @return uint32_t CRC of the header up to the crc field and the ensembles
  */
-void Recorder::setSessionName(const char *const sessionName)
+static uint32_t REC_packetCRC(const uint8_t* pPacket, size_t nBytes)
 {
-    memset(this->currentSessionName, 0, REC_SESSION_NAME_MAX_LEN + 1);
-    strncpy(this->currentSessionName, sessionName, REC_SESSION_NAME_MAX_LEN);
-    SF_OSAL_printf("Setting session name to %s\n", this->currentSessionName);
+    uint32_t crc;
+
+    crc = CRC32_update(CRC32_INIT, pPacket, offsetof(REC_PacketHeader_t, crc));
+    return CRC32_update(crc, pPacket + sizeof(REC_PacketHeader_t), nBytes);
 }
 
 /**
- * @brief Opens a session and configures the Recorder to record data
+ * @brief Checks a packet read back from a session
  * 
- * @return int 1 if successful, otherwise 0
+ * @param pPacket Packet
+ * @param nBytes Number of bytes read
+ * @param pSequence Sequence number, set from the header if there is one
+ * @return int Length of the packet without padding, or -1 if the packet is
+ * corrupt
  */
-int Recorder::openSession(const char *const sessionName)
+static int REC_checkPacket(const uint8_t* pPacket, size_t nBytes, uint16_t* pSequence)
 {
-    memset(this->currentSessionName, 0, REC_SESSION_NAME_MAX_LEN + 1);
-    if (sessionName)
+    const REC_PacketHeader_t* pHeader = (const REC_PacketHeader_t*) pPacket;
+    uint16_t payloadLen;
+
+    if (nBytes < sizeof(REC_PacketHeader_t) || 
+        B_TO_N_ENDIAN_2(pHeader->magic) != REC_PACKET_MAGIC)
     {
-        strncpy(this->currentSessionName, sessionName, REC_SESSION_NAME_MAX_LEN);
+        // recorded before packets had headers
+        return nBytes;
     }
-    this->pSession = &Deployment::getInstance();
-    if (!this->pSession->open("__temp", Deployment::WRITE))
+    payloadLen = B_TO_N_ENDIAN_2(pHeader->nBytes);
+    if (payloadLen > nBytes - sizeof(REC_PacketHeader_t) || 
+        B_TO_N_ENDIAN_2(pHeader->nContinued) > payloadLen)
     {
-        this->pSession = 0;
-        SF_OSAL_printf("REC::OPEN Fail to open\n");
-        return 0;
+        return -1;
     }
-    else
+    if (B_TO_N_ENDIAN_4(pHeader->crc) != REC_packetCRC(pPacket, payloadLen))
     {
-        memset(this->dataBuffer, 0, REC_MEMORY_BUFFER_SIZE);
-        this->dataIdx = 0;
-        SF_OSAL_printf("REC::OPEN opened %s\n", this->currentSessionName);
-        return 1;
+        return -1;
     }
+    *pSequence = B_TO_N_ENDIAN_2(pHeader->sequence);
+    return sizeof(REC_PacketHeader_t) + payloadLen;
 }
 
 /**
- * @brief Closes the current session
+ * @brief Repairs a packet cut short by a reset
  * 
- * If the session was already closed, treated as success.
+ * The header is updated to cover only the bytes that were written, which
+ * may end within a record.  Compressed or delta encoded packets are not
+ * repaired, as a cut short stream does not decode.
  * 
- * @return int  1 if successful, otherwise 0
+ * @param pPacket Packet
+ * @param nBytes Number of bytes read
+ * @return int Length of the repaired packet, or -1 if the packet is not cut
+ * short or cannot be repaired
  */
-int Recorder::closeSession(void)
+static int REC_repairPacket(uint8_t* pPacket, size_t nBytes)
 {
-    char fileName[REC_SESSION_NAME_MAX_LEN + 1];
-    spiffs_stat stat;
+    REC_PacketHeader_t* pHeader = (REC_PacketHeader_t*) pPacket;
+    uint16_t payloadLen;
 
-    if (NULL == this->pSession)
+    if (nBytes <= sizeof(REC_PacketHeader_t) || 
+        B_TO_N_ENDIAN_2(pHeader->magic) != REC_PACKET_MAGIC || 
+        B_TO_N_ENDIAN_2(pHeader->nBytes) <= nBytes - sizeof(REC_PacketHeader_t) ||
+        (B_TO_N_ENDIAN_2(pHeader->flags) & (REC_PACKET_FLAG_DELTA | REC_PACKET_FLAG_COMPRESSED)))
     {
-        SF_OSAL_printf("REC::CLOSE Already closed\n");
-        return 1;
+        return -1;
     }
-
-    // flush buffer
-    for (; this->dataIdx < REC_MAX_PACKET_SIZE; this->dataIdx++)
+    payloadLen = nBytes - sizeof(REC_PacketHeader_t);
+    pHeader->nBytes = N_TO_B_ENDIAN_2(payloadLen);
+    if (B_TO_N_ENDIAN_2(pHeader->nContinued) > payloadLen)
     {
-        this->dataBuffer[this->dataIdx] = 0;
+        pHeader->nContinued = pHeader->nBytes;
     }
-    this->pSession->write(this->dataBuffer, REC_MAX_PACKET_SIZE);
-
-    this->pSession->close();
-    this->getSessionName(fileName);
-    pSystemDesc->pFileSystem->rename("__temp", fileName);
-#ifdef REC_DEBUG
-    SF_OSAL_printf("Saving as %s\n", fileName);
-    pSystemDesc->pFileSystem->stat(fileName, &stat);
-    SF_OSAL_printf("Saved %u bytes\n", stat.size);
-#endif
-    memset(this->dataBuffer, 0, REC_MEMORY_BUFFER_SIZE);
-    this->dataIdx = 0;
-    return 1;
+    pHeader->crc = N_TO_B_ENDIAN_4(REC_packetCRC(pPacket, payloadLen));
+    return nBytes;
 }
 
-void Recorder::getSessionName(char *pFileName)
+/**
+ * @brief Returns the number of bytes of a session not yet uploaded
+ * 
+ * @param pName Session name
+ * @param fileLength Length of the session file
+ * @return size_t Bytes from the start of the session not yet uploaded
+ */
+static size_t REC_getUploadEnd(const char* pName, size_t fileLength)
 {
-    uint32_t i;
-    char tempFileName[REC_SESSION_NAME_MAX_LEN + 1];
-    SpiffsParticleFile fh;
+    char cursorName[SPIFFS_OBJ_NAME_LEN];
+    uint32_t uploadEnd;
 
-    if (this->currentSessionName[0])
+    if (!pSystemDesc->pNvram->get(NVRAM::UPLOAD_CURSOR_NAME, cursorName) ||
+        !pSystemDesc->pNvram->get(NVRAM::UPLOAD_CURSOR_LENGTH, uploadEnd))
     {
-        strcpy(pFileName, this->currentSessionName);
-        return;
+        return fileLength;
     }
-    for (i = 0; i < 100; i++)
+    cursorName[SPIFFS_OBJ_NAME_LEN - 1] = 0;
+    if (strcmp(cursorName, pName) != 0 || uploadEnd > fileLength)
     {
-        snprintf(tempFileName, REC_SESSION_NAME_MAX_LEN, "000000_temp_%02lu", i);
+        return fileLength;
+    }
+    return uploadEnd;
+}
+
+/**
+ * @brief Moves the upload cursor
+ * 
+ * The cursor holds one session.  Before it moves to another session, the
+ * progress of the session it held is saved in the session index, from which
+ * openLastSession restores it, and the cursor is detached.  The length is
+ * written before the name, so that a reset between the two leaves the
+ * length attached to no session.
+ * 
+ * @param pName Session name
+ * @param uploadEnd Bytes from the start of the session not yet uploaded
+ */
+static void REC_setUploadEnd(const char* pName, size_t uploadEnd)
+{
+    char cursorName[SPIFFS_OBJ_NAME_LEN];
+    uint32_t cursorEnd;
+    int idx;
+
+    pSystemDesc->pNvram->get(NVRAM::UPLOAD_CURSOR_NAME, cursorName);
+    cursorName[SPIFFS_OBJ_NAME_LEN - 1] = 0;
+    if (strncmp(cursorName, pName, SPIFFS_OBJ_NAME_LEN) == 0)
+    {
+        pSystemDesc->pNvram->put(NVRAM::UPLOAD_CURSOR_LENGTH, (uint32_t) uploadEnd);
+        return;
+    }
+
+    if (cursorName[0] != 0 && (idx = REC_findSession(cursorName)) >= 0 &&
+        pSystemDesc->pNvram->get(NVRAM::UPLOAD_CURSOR_LENGTH, cursorEnd) &&
+        cursorEnd < REC_sessionIndex[idx].length)
+    {
+        REC_sessionIndex[idx].uploadEnd = cursorEnd;
+        REC_saveIndex();
+        memset(cursorName, 0, SPIFFS_OBJ_NAME_LEN);
+        pSystemDesc->pNvram->put(NVRAM::UPLOAD_CURSOR_NAME, cursorName);
+    }
+
+    pSystemDesc->pNvram->put(NVRAM::UPLOAD_CURSOR_LENGTH, (uint32_t) uploadEnd);
+    memset(cursorName, 0, SPIFFS_OBJ_NAME_LEN);
+    strncpy(cursorName, pName, SPIFFS_OBJ_NAME_LEN - 1);
+    pSystemDesc->pNvram->put(NVRAM::UPLOAD_CURSOR_NAME, cursorName);
+}
+
+/**
+ * @brief Detaches the upload cursor from a session
+ * 
+ * Called when a session is removed or a new session takes its name.
+ * 
+ * @param pName Session name
+ */
+static void REC_clearUploadCursor(const char* pName)
+{
+    char cursorName[SPIFFS_OBJ_NAME_LEN];
+
+    pSystemDesc->pNvram->get(NVRAM::UPLOAD_CURSOR_NAME, cursorName);
+    if (strncmp(cursorName, pName, SPIFFS_OBJ_NAME_LEN) == 0)
+    {
+        memset(cursorName, 0, SPIFFS_OBJ_NAME_LEN);
+        pSystemDesc->pNvram->put(NVRAM::UPLOAD_CURSOR_NAME, cursorName);
+    }
+}
+
+/**
+ * @brief Set the current session name
+ * 
+ * The name is saved for recoverSession only if a session is open and the
+ * name changes, as openSession saves it too.
+ * 
+ * @param sessionName Current name to set
+ */
+void Recorder::setSessionName(const char *const sessionName)
+{
+    if (0 == strncmp(this->currentSessionName, sessionName, REC_SESSION_NAME_MAX_LEN))
+    {
+        return;
+    }
+    memset(this->currentSessionName, 0, REC_SESSION_NAME_MAX_LEN + 1);
+    strncpy(this->currentSessionName, sessionName, REC_SESSION_NAME_MAX_LEN);
+    if (this->isRecording)
+    {
+        pSystemDesc->pNvram->put(NVRAM::SESSION_NAME, this->currentSessionName);
+    }
+    SF_OSAL_printf("Setting session name to %s\n", this->currentSessionName);
+}
+
+/**
+ * @brief Opens a session and configures the Recorder to record data
+ * 
+ * If the expected length is given, the file system is garbage collected
+ * until that much is erased, so that the session's writes do not wait on
+ * garbage collection.
+ * 
+ * @param sessionName Session name, or NULL to name the session when it is
+ * closed
+ * @param expectedLength Most bytes the session is expected to record, 0 to
+ * leave garbage collection to SPIFFS
+ * @return int 1 if successful, otherwise 0
+ */
+int Recorder::openSession(const char *const sessionName, size_t expectedLength)
+{
+    memset(this->currentSessionName, 0, REC_SESSION_NAME_MAX_LEN + 1);
+    if (sessionName)
+    {
+        strncpy(this->currentSessionName, sessionName, REC_SESSION_NAME_MAX_LEN);
+    }
+    this->pSession = &Deployment::getInstance();
+    if (!this->pSession->open(REC_TEMP_SESSION, Deployment::WRITE))
+    {
+        this->pSession = 0;
+        SF_OSAL_printf("REC::OPEN Fail to open\n");
+        return 0;
+    }
+    else
+    {
+        memset(this->pDataBuffer, 0, REC_MAX_PACKET_SIZE);
+        this->dataIdx = sizeof(REC_PacketHeader_t);
+        this->packetSequence = 0;
+        this->packetContinued = 0;
+        this->pendingBytes = 0;
+        this->packetFlags = REC_PACKET_FLAGS;
+        this->unflushedPackets = 0;
+        pSystemDesc->pNvram->put(NVRAM::SESSION_NAME, this->currentSessionName);
+#if SF_REC_DELTA_ENCODING
+        Ens_resetCodec(&this->codec);
+#endif
+#if SF_REC_COMPRESSION
+        this->nPacketRecords = 0;
+        this->encoderFull = 0;
+        LZSS_initEncoder(&this->encoder, this->compressedRecords, REC_MAX_PAYLOAD_SIZE);
+#endif
+        pSystemDesc->pNvram->get(NVRAM::SESSION_ID, this->sessionId);
+        this->sessionId++;
+        pSystemDesc->pNvram->put(NVRAM::SESSION_ID, this->sessionId);
+        memset(&this->queueStats, 0, sizeof(REC_QueueStats_t));
+        REC_preallocate(expectedLength);
+        pSystemDesc->pFileSystem->info(NULL, &this->sessionStartUsed);
+        this->sessionStart_ms = millis();
+        this->isRecording = 1;
+        SF_OSAL_printf("REC::OPEN opened %s\n", this->currentSessionName);
+        return 1;
+    }
+}
+
+/**
+ * @brief Closes the current session
+ * 
+ * If the session was already closed, treated as success.
+ * 
+ * @return int  1 if successful, otherwise 0
+ */
+int Recorder::closeSession(void)
+{
+    char fileName[REC_SESSION_NAME_MAX_LEN + 1];
+    spiffs_stat stat;
+
+    if (NULL == this->pSession)
+    {
+        SF_OSAL_printf("REC::CLOSE Already closed\n");
+        return 1;
+    }
+
+    // flush buffer, the last packet must not be dropped
+    this->commitPendingRecord();
+    this->drainQueue();
+    this->finishPacket();
+    if (this->dataIdx > sizeof(REC_PacketHeader_t))
+    {
+        // the writer is idle, write the last packet without padding
+        this->putPacketHeader();
+        ((REC_PacketHeader_t*) this->pDataBuffer)->crc = N_TO_B_ENDIAN_4(
+            REC_packetCRC(this->pDataBuffer, this->dataIdx - sizeof(REC_PacketHeader_t)));
+        this->pSession->write(this->pDataBuffer, this->dataIdx);
+        this->queueStats.packetsWritten++;
+        this->queueStats.bytesWritten += this->dataIdx;
+        memset(this->pDataBuffer, 0, REC_MAX_PACKET_SIZE);
+        this->dataIdx = sizeof(REC_PacketHeader_t);
+    }
+
+    this->pSession->close();
+    this->isRecording = 0;
+    this->getSessionName(fileName);
+    if (SPIFFS_OK != pSystemDesc->pFileSystem->rename(REC_TEMP_SESSION, fileName) ||
+        SPIFFS_OK != pSystemDesc->pFileSystem->stat(fileName, &stat))
+    {
+        SF_OSAL_printf("REC::CLOSE Fail to save as %s\n", fileName);
+        return 0;
+    }
+    REC_clearUploadCursor(fileName);
+    REC_addSession(fileName, stat.size);
+#ifdef REC_DEBUG
+    SF_OSAL_printf("Saving as %s\n", fileName);
+    SF_OSAL_printf("Saved %u bytes\n", stat.size);
+#endif
+    return 1;
+}
+
+/**
+ * @brief Saves the session that was being recorded when the device reset
+ * 
+ * Keeps the packets up to the last one that checks out.  If the last packet
+ * was cut short and is not encoded, its header is repaired to keep the bytes
+ * that were written, otherwise it is dropped.
+ * The session is saved under the name it had, or a temporary name if it had
+ * none or that name is taken.
+ * 
+ * @return int Number of packets recovered
+ */
+int Recorder::recoverSession(void)
+{
+    Deployment &session = Deployment::getInstance();
+    uint8_t* pPacket = this->packetQueue[0];
+    char fileName[REC_SESSION_NAME_MAX_LEN + 1];
+    size_t length;
+    size_t packetStart;
+    int bytesRead;
+    int packetLen;
+    uint16_t sequence;
+    spiffs_stat stat;
+
+    if (!session.open(REC_TEMP_SESSION, Deployment::RDWR))
+    {
+        return 0;
+    }
+    length = session.getLength();
+    while (length > 0)
+    {
+        packetStart = (length - 1) / REC_MAX_PACKET_SIZE * REC_MAX_PACKET_SIZE;
+        session.seek(packetStart);
+        bytesRead = session.read(pPacket, length - packetStart);
+        packetLen = -1;
+        if (bytesRead >= (int) sizeof(REC_PacketHeader_t) &&
+            B_TO_N_ENDIAN_2(((REC_PacketHeader_t*) pPacket)->magic) != REC_PACKET_MAGIC)
+        {
+            // legacy packets have nothing to check
+            packetLen = bytesRead;
+        }
+        else if (bytesRead >= (int) sizeof(REC_PacketHeader_t))
+        {
+            packetLen = REC_checkPacket(pPacket, bytesRead, &sequence);
+            if (packetLen < 0 && (packetLen = REC_repairPacket(pPacket, bytesRead)) > 0)
+            {
+                session.seek(packetStart);
+                session.write(pPacket, sizeof(REC_PacketHeader_t));
+            }
+        }
+        if (packetLen > 0)
+        {
+            length = packetStart + packetLen;
+            break;
+        }
+        length = packetStart;
+    }
+    if (length == 0)
+    {
+        session.remove();
+        return 0;
+    }
+    if (length < session.getLength())
+    {
+        session.truncate(length);
+    }
+    session.close();
+
+    pSystemDesc->pNvram->get(NVRAM::SESSION_NAME, this->currentSessionName);
+    this->currentSessionName[REC_SESSION_NAME_MAX_LEN] = 0;
+    if (!REC_isValidName(this->currentSessionName))
+    {
+        memset(this->currentSessionName, 0, REC_SESSION_NAME_MAX_LEN + 1);
+    }
+    this->getSessionName(fileName);
+    if (SPIFFS_OK != pSystemDesc->pFileSystem->rename(REC_TEMP_SESSION, fileName))
+    {
+        memset(this->currentSessionName, 0, REC_SESSION_NAME_MAX_LEN + 1);
+        this->getSessionName(fileName);
+        pSystemDesc->pFileSystem->rename(REC_TEMP_SESSION, fileName);
+    }
+    memset(this->currentSessionName, 0, REC_SESSION_NAME_MAX_LEN + 1);
+    if (SPIFFS_OK != pSystemDesc->pFileSystem->stat(fileName, &stat))
+    {
+        SF_OSAL_printf("REC::RECOVER Fail to save as %s\n", fileName);
+        return 0;
+    }
+    REC_clearUploadCursor(fileName);
+    REC_addSession(fileName, stat.size);
+    FLOG_AddError(FLOG_REC_RECOVERED, (stat.size + REC_MAX_PACKET_SIZE - 1) / REC_MAX_PACKET_SIZE);
+    SF_OSAL_printf("Recovered %s, %u bytes\n", fileName, stat.size);
+    return (stat.size + REC_MAX_PACKET_SIZE - 1) / REC_MAX_PACKET_SIZE;
+}
+
+/**
+ * @brief Erases free space for a session before it records
+ * 
+ * SPIFFS only erases blocks when a write runs out of erased pages, moving
+ * the live pages out of blocks of deleted pages in the middle of the write.
+ * Erasing stops after SF_REC_PREALLOCATE_MAX_MS, so that a full file system
+ * does not hold up the start of the session.
+ * 
+ * @param nBytes Expected session length
+ */
+static void REC_preallocate(size_t nBytes)
+{
+    system_tick_t start = millis();
+    uint32_t total, used;
+    uint32_t i;
+
+    if (nBytes == 0 || SPIFFS_OK != pSystemDesc->pFileSystem->info(&total, &used) ||
+        used >= total)
+    {
+        return;
+    }
+    nBytes += REC_PREALLOCATE_MARGIN;
+    if (nBytes > total - used)
+    {
+        // SPIFFS_gc does nothing if asked for more than it can free
+        nBytes = total - used;
+    }
+    for (i = 0; i < REC_PREALLOCATE_MAX_GC && millis() - start < SF_REC_PREALLOCATE_MAX_MS; i++)
+    {
+        // SPIFFS_ERR_FULL until enough is erased
+        if (SPIFFS_ERR_FULL != pSystemDesc->pFileSystem->gc(nBytes))
+        {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Makes one step of idle file system maintenance
+ * 
+ * Erases a block of deleted pages, or failing that garbage collects one
+ * block, until the next session's expected length is erased.  A step takes
+ * at most one block erase and the moves of that block's live pages, so idle
+ * states call this between their checks for water.
+ * 
+ * @param nBytes Expected length of the next session, see openSession
+ * @return int 1 if more erased space was made, 0 if there is enough or
+ * nothing more can be freed
+ */
+int Recorder::eraseAhead(size_t nBytes)
+{
+    SpiffsParticle* pFs = pSystemDesc->pFileSystem;
+    uint32_t erased = pFs->getErasedBytes();
+
+    if (erased >= nBytes + REC_PREALLOCATE_MARGIN)
+    {
+        return 0;
+    }
+    if (SPIFFS_OK == pFs->gcQuick(0))
+    {
+        return 1;
+    }
+    // asking for one byte more than is erased collects a single block
+    pFs->gc(erased + 1);
+    return pFs->getErasedBytes() > erased;
+}
+
+/**
+ * @brief Checks a session name read back from NVRAM
+ * 
+ * @param pName Name
+ * @return int 1 if the name is printable and not empty, otherwise 0
+ */
+static int REC_isValidName(const char* pName)
+{
+    const char* pChar;
+
+    for (pChar = pName; *pChar; pChar++)
+    {
+        if (*pChar < ' ' || *pChar > '~')
+        {
+            return 0;
+        }
+    }
+    return pChar != pName;
+}
+
+void Recorder::getSessionName(char *pFileName)
+{
+    uint32_t i;
+    char tempFileName[REC_SESSION_NAME_MAX_LEN + 1];
+    SpiffsParticleFile fh;
+
+    if (this->currentSessionName[0])
+    {
+        strcpy(pFileName, this->currentSessionName);
+        return;
+    }
+    for (i = 0; i < 100; i++)
+    {
+        snprintf(tempFileName, REC_SESSION_NAME_MAX_LEN, "000000_temp_%02lu", i);
         fh = pSystemDesc->pFileSystem->openFile(tempFileName, SPIFFS_O_RDONLY);
         if (fh.isValid())
         {
@@ -367,28 +1068,430 @@ void Recorder::getSessionName(char *pFileName)
 
 int Recorder::putBytes(const void *pData, size_t nBytes)
 {
-    if (NULL == this->pSession)
+    void* pDest;
+
+    pDest = this->reserveBytes(nBytes);
+    if (NULL == pDest)
     {
         return 0;
     }
+    memcpy(pDest, pData, nBytes);
+    return 1;
+}
+
+/**
+ * @brief Reserves space for data in the current packet
+ * 
+ * If the data does not fit in the current packet, the packet is flushed
+ * first.  If records are encoded or compressed, the space is a staging
+ * buffer that is put into the packet on the next reserveBytes or
+ * closeSession.
+ * 
+ * @param nBytes Number of bytes to reserve
+ * @return void* Space for nBytes of data, or NULL if no session is open or
+ * nBytes is larger than REC_MAX_RECORD_SIZE
+ */
+void* Recorder::reserveBytes(size_t nBytes)
+{
+#if !SF_REC_DELTA_ENCODING && !SF_REC_COMPRESSION
+    void* pDest;
+#endif
+
+    if (NULL == this->pSession || nBytes > REC_MAX_RECORD_SIZE)
+    {
+        return NULL;
+    }
+    this->commitPendingRecord();
+#if SF_REC_DELTA_ENCODING || SF_REC_COMPRESSION
+    // the encoded length is only known once the record is written
+    this->pendingBytes = nBytes;
+    return this->pendingRecord;
+#else
     if (nBytes > (REC_MAX_PACKET_SIZE - this->dataIdx))
     {
-        // data will not fit, flush and clear
-        // pad 0
-        for (; this->dataIdx < REC_MAX_PACKET_SIZE; this->dataIdx++)
+#if SF_REC_SPLIT_RECORDS
+        if (this->dataIdx < REC_MAX_PACKET_SIZE)
         {
-            this->dataBuffer[this->dataIdx] = 0;
+            // assemble the record, then split it across this packet and the
+            // next
+            this->pendingBytes = nBytes;
+            return this->pendingRecord;
         }
+#endif
+        // data will not fit, hand the packet to the writer
         SF_OSAL_printf("Flushing\n");
-        this->pSession->write(this->dataBuffer, REC_MAX_PACKET_SIZE);
-
-        memset(this->dataBuffer, 0, REC_MEMORY_BUFFER_SIZE);
-        this->dataIdx = 0;
+        this->sealPacket();
     }
 
     // data guaranteed to fit
     SF_OSAL_printf("Putting %u bytes\n", nBytes);
-    memcpy(&this->dataBuffer[this->dataIdx], pData, nBytes);
+    pDest = &this->pDataBuffer[this->dataIdx];
     this->dataIdx += nBytes;
+    return pDest;
+#endif
+}
+
+/**
+ * @brief Puts the pending record into the current packet
+ * 
+ * The record is encoded first if records are encoded.  If it does not fit,
+ * it is split across the current packet and the next, or without
+ * SF_REC_SPLIT_RECORDS or with SF_REC_COMPRESSION, put in the next packet.
+ * 
+ */
+void Recorder::commitPendingRecord(void)
+{
+    const uint8_t* pRecord = this->pendingRecord;
+    size_t nBytes = this->pendingBytes;
+#if !SF_REC_COMPRESSION
+    size_t nFirst;
+#endif
+
+    if (0 == this->pendingBytes)
+    {
+        return;
+    }
+#if SF_REC_DELTA_ENCODING && !SF_REC_COMPRESSION
+    if (this->dataIdx == REC_MAX_PACKET_SIZE)
+    {
+        this->sealPacket();
+    }
+#endif
+#if SF_REC_DELTA_ENCODING
+    nBytes = Ens_encodeRecord(&this->codec, this->pendingRecord, this->pendingBytes, 
+        this->encodedRecord);
+    pRecord = this->encodedRecord;
+#endif
+
+#if SF_REC_COMPRESSION
+    if (!this->compressRecord(pRecord, nBytes))
+    {
+        this->sealPacket();
+#if SF_REC_DELTA_ENCODING
+        // encode the record again as the first of the next packet
+        nBytes = Ens_encodeRecord(&this->codec, this->pendingRecord, this->pendingBytes, 
+            this->encodedRecord);
+#endif
+        this->compressRecord(pRecord, nBytes);
+    }
+    this->pendingBytes = 0;
+#else
+#if SF_REC_DELTA_ENCODING && !SF_REC_SPLIT_RECORDS
+    if (nBytes > REC_MAX_PACKET_SIZE - this->dataIdx)
+    {
+        // encode the record again as the first of the next packet
+        this->sealPacket();
+        nBytes = Ens_encodeRecord(&this->codec, this->pendingRecord, this->pendingBytes, 
+            this->encodedRecord);
+    }
+#endif
+    this->pendingBytes = 0;
+    if (nBytes <= REC_MAX_PACKET_SIZE - this->dataIdx)
+    {
+        memcpy(&this->pDataBuffer[this->dataIdx], pRecord, nBytes);
+        this->dataIdx += nBytes;
+        return;
+    }
+
+    nFirst = REC_MAX_PACKET_SIZE - this->dataIdx;
+    memcpy(&this->pDataBuffer[this->dataIdx], pRecord, nFirst);
+    this->dataIdx += nFirst;
+    this->sealPacket();
+    memcpy(&this->pDataBuffer[this->dataIdx], pRecord + nFirst, nBytes - nFirst);
+    this->dataIdx += nBytes - nFirst;
+    this->packetContinued = nBytes - nFirst;
+#endif
+}
+
+#if SF_REC_COMPRESSION
+/**
+ * @brief Adds a record to the current packet and compresses it
+ * 
+ * @param pRecord Record
+ * @param nBytes Length of the record
+ * @return int 1 if the record fits the packet compressed or uncompressed,
+ * otherwise 0 and the packet is unchanged
+ */
+int Recorder::compressRecord(const uint8_t* pRecord, size_t nBytes)
+{
+    int compressed;
+
+    if (this->nPacketRecords + nBytes > LZSS_MAX_INPUT_LEN)
+    {
+        return 0;
+    }
+    memcpy(&this->packetRecords[this->nPacketRecords], pRecord, nBytes);
+    compressed = !this->encoderFull && 
+        LZSS_compress(&this->encoder, this->packetRecords, this->nPacketRecords + nBytes);
+    if (!compressed)
+    {
+        if (this->nPacketRecords + nBytes > REC_MAX_PAYLOAD_SIZE)
+        {
+            return 0;
+        }
+        this->encoderFull = 1;
+    }
+    this->nPacketRecords += nBytes;
     return 1;
-}
\ No newline at end of file
+}
+#endif
+
+/**
+ * @brief Puts the compressed ensembles into the current packet, or the
+ * ensembles if compression does not make them smaller
+ * 
+ */
+void Recorder::finishPacket(void)
+{
+#if SF_REC_COMPRESSION
+    size_t nCompressed = LZSS_getLength(&this->encoder);
+
+    if (!this->encoderFull && nCompressed < this->nPacketRecords)
+    {
+        memcpy(&this->pDataBuffer[this->dataIdx], this->compressedRecords, nCompressed);
+        this->dataIdx += nCompressed;
+        this->packetFlags |= REC_PACKET_FLAG_COMPRESSED;
+    }
+    else
+    {
+        memcpy(&this->pDataBuffer[this->dataIdx], this->packetRecords, this->nPacketRecords);
+        this->dataIdx += this->nPacketRecords;
+    }
+    this->nPacketRecords = 0;
+    this->encoderFull = 0;
+    LZSS_initEncoder(&this->encoder, this->compressedRecords, REC_MAX_PAYLOAD_SIZE);
+#endif
+}
+
+/**
+ * @brief Queues the current packet for the writer and starts a new one
+ * 
+ * Never waits for flash.  If every other buffer is still waiting for the
+ * writer, the packet is dropped and its buffer reused.  The unused tail of
+ * the packet is already zero.  The writer computes the CRC.
+ * 
+ */
+void Recorder::sealPacket(void)
+{
+    uint32_t head = this->queueHead.load(std::memory_order_relaxed);
+    uint32_t depth = head + 1 - this->queueTail.load(std::memory_order_acquire);
+
+    this->finishPacket();
+    this->putPacketHeader();
+
+    if (depth >= REC_PACKET_QUEUE_LEN)
+    {
+        this->queueStats.droppedPackets++;
+        FLOG_AddError(FLOG_REC_PACKET_DROP, (uint16_t) this->queueStats.droppedPackets);
+    }
+    else
+    {
+        head++;
+        this->queueHead.store(head, std::memory_order_release);
+        if (depth > this->queueStats.maxDepth)
+        {
+            this->queueStats.maxDepth = depth;
+        }
+        if (this->hasWriterThread)
+        {
+            // already pending if the writer has not woken since the last one
+            os_semaphore_give(REC_writerSignal, false);
+        }
+        else
+        {
+            this->writeQueuedPackets();
+        }
+    }
+    this->pDataBuffer = this->packetQueue[head % REC_PACKET_QUEUE_LEN];
+    memset(this->pDataBuffer, 0, REC_MAX_PACKET_SIZE);
+    this->dataIdx = sizeof(REC_PacketHeader_t);
+#if SF_REC_DELTA_ENCODING
+    Ens_resetCodec(&this->codec);
+#endif
+}
+
+/**
+ * @brief Fills in the header of the current packet, except for the CRC
+ * 
+ */
+void Recorder::putPacketHeader(void)
+{
+    REC_PacketHeader_t* pHeader = (REC_PacketHeader_t*) this->pDataBuffer;
+
+    pHeader->magic = N_TO_B_ENDIAN_2(REC_PACKET_MAGIC);
+    pHeader->sequence = N_TO_B_ENDIAN_2(this->packetSequence);
+    pHeader->sessionId = N_TO_B_ENDIAN_4(this->sessionId);
+    pHeader->nBytes = N_TO_B_ENDIAN_2(this->dataIdx - sizeof(REC_PacketHeader_t));
+    pHeader->nContinued = N_TO_B_ENDIAN_2(this->packetContinued);
+    pHeader->flags = N_TO_B_ENDIAN_2(this->packetFlags);
+    this->packetSequence++;
+    this->packetContinued = 0;
+    this->packetFlags = REC_PACKET_FLAGS;
+}
+
+/**
+ * @brief Waits until the writer has written every sealed packet
+ * 
+ */
+void Recorder::drainQueue(void)
+{
+    while (this->queueTail.load(std::memory_order_acquire) != 
+        this->queueHead.load(std::memory_order_relaxed))
+    {
+        if (this->hasWriterThread)
+        {
+            delay(1);
+        }
+        else
+        {
+            this->writeQueuedPackets();
+        }
+    }
+}
+
+/**
+ * @brief Writes all sealed packets to the session
+ * 
+ * Only called by the writer thread, or by the ensembles if there is no
+ * writer thread.
+ * 
+ * @return int Number of packets written
+ */
+int Recorder::writeQueuedPackets(void)
+{
+    uint32_t tail = this->queueTail.load(std::memory_order_relaxed);
+    uint32_t head = this->queueHead.load(std::memory_order_acquire);
+    int nPackets = 0;
+    uint8_t* pPacket;
+    REC_PacketHeader_t* pHeader;
+    uint32_t writeStart_us;
+    uint32_t writeTime_us;
+
+    for (; tail != head; tail++)
+    {
+        pPacket = this->packetQueue[tail % REC_PACKET_QUEUE_LEN];
+        pHeader = (REC_PacketHeader_t*) pPacket;
+        pHeader->crc = N_TO_B_ENDIAN_4(REC_packetCRC(pPacket, B_TO_N_ENDIAN_2(pHeader->nBytes)));
+        writeStart_us = micros();
+        this->pSession->write(pPacket, REC_MAX_PACKET_SIZE);
+        this->queueStats.packetsWritten++;
+        this->queueStats.bytesWritten += REC_MAX_PACKET_SIZE;
+        this->queueStats.paddingBytes += REC_MAX_PAYLOAD_SIZE - B_TO_N_ENDIAN_2(pHeader->nBytes);
+        if (0 == this->unflushedPackets++)
+        {
+            this->firstUnflushed_ms = millis();
+        }
+        // the session is the ensembles' again once the queue is empty
+        this->flushIfDue();
+        writeTime_us = micros() - writeStart_us;
+        if (writeTime_us > this->queueStats.maxWriteTime_us)
+        {
+            this->queueStats.maxWriteTime_us = writeTime_us;
+        }
+        this->queueTail.store(tail + 1, std::memory_order_release);
+        nPackets++;
+    }
+    return nPackets;
+}
+
+/**
+ * @brief Flushes the session if SF_REC_FLUSH_MODE calls for it
+ * 
+ * Only called by the writer after writing a packet.  The session is always
+ * flushed when it is closed.
+ * 
+ */
+void Recorder::flushIfDue(void)
+{
+#if SF_REC_FLUSH_MODE != SF_REC_FLUSH_ON_CLOSE
+#if SF_REC_FLUSH_MODE == SF_REC_FLUSH_PERIODIC
+    if (this->unflushedPackets < SF_REC_FLUSH_PACKETS && 
+        millis() - this->firstUnflushed_ms < SF_REC_FLUSH_INTERVAL_MS)
+    {
+        return;
+    }
+#endif
+    this->pSession->flush();
+    this->unflushedPackets = 0;
+    this->queueStats.flushes++;
+#endif
+}
+
+/**
+ * @brief Copies the packet queue statistics of the current session
+ * 
+ * @param pStats Statistics to fill
+ */
+void Recorder::getQueueStats(REC_QueueStats_t* pStats) const
+{
+    memcpy(pStats, &this->queueStats, sizeof(REC_QueueStats_t));
+}
+
+void Recorder::displayQueueStats(void) const
+{
+    SF_OSAL_printf("Writer thread:   %s\n", this->hasWriterThread ? "running" : "none");
+    SF_OSAL_printf("Queue length:    %u\n", REC_PACKET_QUEUE_LEN - 1);
+    SF_OSAL_printf("Packets written: %lu\n", this->queueStats.packetsWritten);
+    SF_OSAL_printf("Max queue depth: %lu\n", this->queueStats.maxDepth);
+    SF_OSAL_printf("Dropped packets: %lu\n", this->queueStats.droppedPackets);
+    SF_OSAL_printf("Corrupt packets: %lu\n", this->queueStats.corruptPackets);
+    SF_OSAL_printf("Flushes:         %lu\n", this->queueStats.flushes);
+    SF_OSAL_printf("Longest write:   %lu us\n", this->queueStats.maxWriteTime_us);
+    SF_OSAL_printf("Bytes written:   %lu\n", this->queueStats.bytesWritten);
+    SF_OSAL_printf("Padding bytes:   %lu\n", this->queueStats.paddingBytes);
+}
+
+/**
+ * @brief Projects how many minutes of recording the file system has left
+ * 
+ * Once the current session has recorded for REC_FORECAST_MIN_MS, the rate
+ * is the growth of the file system since the session was opened, which
+ * includes the packet padding and the SPIFFS overhead.  Otherwise the rate
+ * is estimated from the records scheduled, stored at REC_STORED_PERCENT of
+ * their size.
+ * 
+ * @param pForecast Forecast to fill
+ * @param recordBytesPerMinute Bytes of records scheduled per minute
+ * @return int 1 if successful, otherwise 0
+ */
+int Recorder::getStorageForecast(REC_StorageForecast_t* pForecast, uint32_t recordBytesPerMinute)
+{
+    uint32_t elapsed_ms;
+    uint64_t rate;
+
+    memset(pForecast, 0, sizeof(REC_StorageForecast_t));
+    if (SPIFFS_OK != pSystemDesc->pFileSystem->info(&pForecast->totalBytes, &pForecast->usedBytes))
+    {
+        return 0;
+    }
+
+    elapsed_ms = millis() - this->sessionStart_ms;
+    if (this->isRecording && elapsed_ms >= REC_FORECAST_MIN_MS && 
+        pForecast->usedBytes > this->sessionStartUsed)
+    {
+        rate = (uint64_t) (pForecast->usedBytes - this->sessionStartUsed) * 60000 / elapsed_ms;
+        pForecast->measured = 1;
+    }
+    else
+    {
+        rate = (uint64_t) recordBytesPerMinute * REC_STORED_PERCENT / 100;
+    }
+    pForecast->bytesPerMinute = rate > UINT32_MAX ? UINT32_MAX : rate;
+
+    if (this->queueStats.bytesWritten)
+    {
+        pForecast->paddingPercent = (uint64_t) this->queueStats.paddingBytes * 100 / 
+            this->queueStats.bytesWritten;
+    }
+
+    if (0 == pForecast->bytesPerMinute)
+    {
+        pForecast->minutesRemaining = UINT32_MAX;
+    }
+    else if (pForecast->usedBytes < pForecast->totalBytes)
+    {
+        pForecast->minutesRemaining = (pForecast->totalBytes - pForecast->usedBytes) / 
+            pForecast->bytesPerMinute;
+    }
+    return 1;
+}
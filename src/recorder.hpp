@@ -2,9 +2,12 @@
 #define __RECORDER_HPP__
 
 #include "SpiffsParticleRK.h"
+#include <atomic>
 #include <stddef.h>
 #include "deploy.hpp"
 #include "conio.hpp"
+#include "ensembleCodec.hpp"
+#include "lzss.hpp"
 #include "product.hpp"
 
 /**
@@ -13,13 +16,254 @@
  */
 #define REC_SESSION_NAME_MAX_LEN 31
 
-#define REC_MEMORY_BUFFER_SIZE  512
 #if SF_UPLOAD_ENCODING == SF_UPLOAD_BASE85
 #define REC_MAX_PACKET_SIZE  496
 #elif SF_UPLOAD_ENCODING == SF_UPLOAD_BASE64 || SF_UPLOAD_ENCODING == SF_UPLOAD_BASE64URL
 #define REC_MAX_PACKET_SIZE  466
 #endif
 
+/**
+ * @brief Packet header
+ * 
+ * Every packet in a session file starts with this header, big-endian,
+ * followed by nBytes of ensembles.  All but the last packet of a session
+ * are zero padded to REC_MAX_PACKET_SIZE, so packet n starts at
+ * n * REC_MAX_PACKET_SIZE.  Packets are uploaded without the padding.
+ * 
+ * With SF_REC_SPLIT_RECORDS, a record that does not fit the rest of a
+ * packet fills it and continues at the start of the next packet.  The first
+ * nContinued bytes of a packet finish such a record; a decoder that does
+ * not have the previous packet skips them.
+ * 
+ * With SF_REC_DELTA_ENCODING, REC_PACKET_FLAG_DELTA is set and the
+ * ensembles are encoded by Ens_encodeRecord, with the codec reset at the
+ * start of the packet.  A continued record is encoded against the previous
+ * packet, and the codec is reset after it.
+ * 
+ * With SF_REC_COMPRESSION, packets hold up to LZSS_MAX_INPUT_LEN bytes of
+ * ensembles, and REC_PACKET_FLAG_COMPRESSED is set if the nBytes after the
+ * header are those ensembles compressed by LZSS_compress.  Records are then
+ * never split, so nContinued is 0.
+ * 
+ * crc is the CRC-32 of the header up to crc followed by the nBytes after
+ * the header, as stored.
+ */
+#pragma pack(push, 1)
+typedef struct REC_PacketHeader_
+{
+    /**
+     * @brief REC_PACKET_MAGIC
+     * 
+     */
+    uint16_t magic;
+    /**
+     * @brief Packet number in the session, starting from 0.  Dropped packets
+     * leave a gap.
+     * 
+     */
+    uint16_t sequence;
+    /**
+     * @brief Session number, increments with every session on a device
+     * 
+     */
+    uint32_t sessionId;
+    /**
+     * @brief Number of bytes after the header
+     * 
+     */
+    uint16_t nBytes;
+    /**
+     * @brief Number of bytes at the start of the ensembles that finish a
+     * record begun in the previous packet
+     * 
+     */
+    uint16_t nContinued;
+    /**
+     * @brief REC_PACKET_FLAG_*
+     * 
+     */
+    uint16_t flags;
+    uint32_t crc;
+}REC_PacketHeader_t;
+#pragma pack(pop)
+
+#define REC_PACKET_MAGIC    0x5346
+
+/**
+ * @brief Ensembles are delta encoded
+ * 
+ */
+#define REC_PACKET_FLAG_DELTA       0x0001
+/**
+ * @brief Ensembles are compressed
+ * 
+ */
+#define REC_PACKET_FLAG_COMPRESSED  0x0002
+
+/**
+ * @brief Maximum number of bytes of ensembles in a packet
+ * 
+ */
+#define REC_MAX_PAYLOAD_SIZE    (REC_MAX_PACKET_SIZE - sizeof(REC_PacketHeader_t))
+
+/**
+ * @brief Largest record reserveBytes accepts
+ * 
+ */
+#if SF_REC_DELTA_ENCODING
+#define REC_MAX_RECORD_SIZE (REC_MAX_PAYLOAD_SIZE - ENS_CODEC_MAX_OVERHEAD)
+#else
+#define REC_MAX_RECORD_SIZE REC_MAX_PAYLOAD_SIZE
+#endif
+
+/**
+ * @brief Number of packet buffers
+ * 
+ * The ensembles fill one buffer while the others wait for the writer thread,
+ * so up to REC_PACKET_QUEUE_LEN - 1 sealed packets can be queued.  Must be a
+ * power of two.
+ */
+#define REC_PACKET_QUEUE_LEN    4
+
+/**
+ * @brief Maximum number of sessions in the session index
+ * 
+ * Sessions beyond this are indexed as indexed sessions are uploaded.
+ */
+#define REC_SESSION_INDEX_LEN   64
+#define REC_SESSION_INDEX_FILE  ".sessions"
+#define REC_SESSION_INDEX_MAGIC 0x53455331
+
+/**
+ * @brief Session index entry
+ * 
+ */
+typedef struct REC_SessionEntry_
+{
+    char name[SPIFFS_OBJ_NAME_LEN];
+    /**
+     * @brief Length of the session file
+     * 
+     */
+    uint32_t length;
+    /**
+     * @brief Bytes from the start of the session not yet uploaded
+     * 
+     */
+    uint32_t uploadEnd;
+}REC_SessionEntry_t;
+
+typedef struct REC_QueueStats_
+{
+    /**
+     * @brief Packets written to flash
+     * 
+     */
+    uint32_t packetsWritten;
+    /**
+     * @brief Most sealed packets waiting for the writer at once
+     * 
+     */
+    uint32_t maxDepth;
+    /**
+     * @brief Packets discarded because every buffer was waiting for the
+     * writer
+     * 
+     */
+    uint32_t droppedPackets;
+    /**
+     * @brief Packets skipped on upload because their CRC did not match
+     * 
+     */
+    uint32_t corruptPackets;
+    /**
+     * @brief Session flushes, see SF_REC_FLUSH_MODE
+     * 
+     */
+    uint32_t flushes;
+    /**
+     * @brief Longest time taken to write and flush a packet, in us
+     * 
+     */
+    uint32_t maxWriteTime_us;
+    /**
+     * @brief Bytes written to the session, including the padding
+     * 
+     */
+    uint32_t bytesWritten;
+    /**
+     * @brief Zero padding written to fill packets to REC_MAX_PACKET_SIZE
+     * 
+     */
+    uint32_t paddingBytes;
+}REC_QueueStats_t;
+
+/**
+ * @brief Least time a session must have recorded before its rate is used to
+ * forecast, in ms
+ * 
+ * Before this the rate is estimated from the records scheduled.
+ */
+#define REC_FORECAST_MIN_MS 60000
+
+/**
+ * @brief File system bytes used per 100 bytes of records
+ * 
+ * Covers the delta encoding, compression, packet headers and padding, and
+ * the SPIFFS overhead.  Measured with host/scheduleSim over a 120 minute
+ * ride.
+ */
+#if SF_REC_DELTA_ENCODING && SF_REC_COMPRESSION
+#define REC_STORED_PERCENT  53
+#elif SF_REC_COMPRESSION
+#define REC_STORED_PERCENT  61
+#elif SF_REC_DELTA_ENCODING
+#define REC_STORED_PERCENT  66
+#else
+#define REC_STORED_PERCENT  103
+#endif
+
+/**
+ * @brief Projection of how long the file system can keep recording
+ * 
+ */
+typedef struct REC_StorageForecast_
+{
+    /**
+     * @brief Bytes the file system can hold, from SPIFFS_info
+     * 
+     */
+    uint32_t totalBytes;
+    /**
+     * @brief Bytes the file system holds, from SPIFFS_info
+     * 
+     */
+    uint32_t usedBytes;
+    /**
+     * @brief Bytes of file system used per minute of recording, after
+     * encoding and compression
+     * 
+     */
+    uint32_t bytesPerMinute;
+    /**
+     * @brief Minutes of recording until the file system is full,
+     * UINT32_MAX if nothing is recorded
+     * 
+     */
+    uint32_t minutesRemaining;
+    /**
+     * @brief Share of the bytes written that is zero padding, in percent
+     * 
+     */
+    uint8_t paddingPercent;
+    /**
+     * @brief 1 if bytesPerMinute was measured over the current session, 0 if
+     * estimated from the records scheduled
+     * 
+     */
+    uint8_t measured;
+}REC_StorageForecast_t;
+
 class Recorder
 {
     public:
@@ -28,13 +272,20 @@ class Recorder
     int getLastPacket(void* pBuffer, size_t bufferLen, char* pName, size_t nameLen);
     void resetPacketNumber(void);
     void incrementPacketNumber(void);
-    int popLastPacket(size_t len);
+    int popLastPacket(void);
     void setSessionName(const char* const);
     int getNumFiles(void);
+    int rebuildIndex(void);
 
-    int openSession(const char* const depName);
+    int openSession(const char* const depName, size_t expectedLength = 0);
     int closeSession(void);
     int putBytes(const void* pData, size_t nBytes);
+    void* reserveBytes(size_t nBytes);
+    int writeQueuedPackets(void);
+    int eraseAhead(size_t nBytes);
+    void getQueueStats(REC_QueueStats_t* pStats) const;
+    void displayQueueStats(void) const;
+    int getStorageForecast(REC_StorageForecast_t* pForecast, uint32_t recordBytesPerMinute);
 
     template <typename T> int putData(T& data)
     {
@@ -49,13 +300,85 @@ class Recorder
     };
     char currentSessionName[REC_SESSION_NAME_MAX_LEN + 1];
     char lastSessionName[REC_SESSION_NAME_MAX_LEN + 1];
-    uint8_t dataBuffer[REC_MEMORY_BUFFER_SIZE];
+    size_t lastPacketStart;
+    uint8_t packetQueue[REC_PACKET_QUEUE_LEN][REC_MAX_PACKET_SIZE];
+    /**
+     * @brief Number of packets sealed, only written by the ensembles
+     * 
+     */
+    std::atomic<uint32_t> queueHead;
+    /**
+     * @brief Number of packets written, only written by the writer thread
+     * 
+     */
+    std::atomic<uint32_t> queueTail;
+    uint8_t* pDataBuffer;
     uint32_t dataIdx;
+    uint32_t sessionId;
+    uint16_t packetSequence;
+    uint16_t packetContinued;
+    /**
+     * @brief Record that did not fit the current packet, or any record if
+     * records are encoded, committed on the next reserveBytes or closeSession
+     * 
+     */
+    uint8_t pendingRecord[REC_MAX_PACKET_SIZE];
+    size_t pendingBytes;
+#if SF_REC_DELTA_ENCODING
+    EnsembleCodec_t codec;
+    uint8_t encodedRecord[REC_MAX_PACKET_SIZE];
+#endif
+#if SF_REC_COMPRESSION
+    /**
+     * @brief Ensembles of the current packet, before compression
+     * 
+     */
+    uint8_t packetRecords[LZSS_MAX_INPUT_LEN];
+    size_t nPacketRecords;
+    uint8_t compressedRecords[REC_MAX_PAYLOAD_SIZE];
+    LZSS_Encoder_t encoder;
+    /**
+     * @brief The compressed ensembles no longer fit the packet, the packet
+     * is stored uncompressed
+     * 
+     */
+    int encoderFull;
+#endif
+    uint16_t packetFlags;
     Deployment* pSession;
+    os_thread_t writerThread;
+    int hasWriterThread;
+    /**
+     * @brief Packets written since the last flush, only used by the writer
+     * 
+     */
+    uint32_t unflushedPackets;
+    system_tick_t firstUnflushed_ms;
+    REC_QueueStats_t queueStats;
+    /**
+     * @brief A session is open, and sessionStart_ms and sessionStartUsed
+     * hold when it was opened
+     * 
+     */
+    int isRecording;
+    system_tick_t sessionStart_ms;
+    /**
+     * @brief File system bytes used when the session was opened
+     * 
+     */
+    uint32_t sessionStartUsed;
 
     void getSessionName(char* fileName);
+    void sealPacket(void);
+    void putPacketHeader(void);
+    void commitPendingRecord(void);
+    int compressRecord(const uint8_t* pRecord, size_t nBytes);
+    void finishPacket(void);
+    void drainQueue(void);
+    void flushIfDue(void);
+    int recoverSession(void);
 
-    int openLastSession(Deployment &session, char* pName);
+    int openLastSession(Deployment &session);
 };
 
 #endif
\ No newline at end of file
@@ -12,62 +12,161 @@
 #include "utils.hpp"
 #include "vers.hpp"
 #include "scheduler.hpp"
+#include "scheduleTable.hpp"
+#include "ensembleAccumulator.hpp"
 #include "flog.hpp"
 
-static void RIDE_setFileName(system_tick_t startTime);
+static int RIDE_setFileName(system_tick_t startTime);
 
-static void SS_ensemble10Func(DeploymentSchedule_t* pDeployment);
-static void SS_ensemble10Init(DeploymentSchedule_t* pDeployment);
-
-static void SS_ensemble07Func(DeploymentSchedule_t* pDeployment);
-static void SS_ensemble07Init(DeploymentSchedule_t* pDeployment);
+static inline uint16_t RIDE_saturate16(uint32_t value)
+{
+    return value > UINT16_MAX ? UINT16_MAX : value;
+}
 
-static void SS_ensemble08Func(DeploymentSchedule_t* pDeployment);
-static void SS_ensemble08Init(DeploymentSchedule_t* pDeployment);
+/**
+ * @brief Accelerometer x, y, z and gyroscope x, y, z
+ * 
+ */
+typedef EnsembleAccumulator<int16_t, int16_t, int16_t, int16_t, int16_t, int16_t> Ensemble10_eventData_t;
+/**
+ * @brief Battery voltage in mV
+ * 
+ */
+typedef EnsembleAccumulator<uint16_t> Ensemble07_eventData_t;
+/**
+ * @brief Raw temperature and water
+ * 
+ */
+typedef EnsembleAccumulator<int16_t, uint8_t> Ensemble08_eventData_t;
 
-static void SS_fwVerInit(DeploymentSchedule_t* pDeployment);
-static void SS_fwVerFunc(DeploymentSchedule_t* pDeployment);
+#pragma pack(push, 1)
+typedef struct RIDE_FwVersion_data_
+{
+    uint8_t nChars;
+    char verBuf[32];
+}RIDE_FwVersion_data_t;
+#pragma pack(pop)
 
-typedef struct Ensemble10_eventData_
+/**
+ * @brief Ensemble 10/11 - Temperature, IMU and GPS every second
+ * 
+ * The IMU is oversampled and the record holds the mean of the samples.  The
+ * temperature, water, compass and GPS are read once per record.
+ */
+struct RIDE_Ensemble10 : SCH_EnsembleDefaults
 {
-    double temperature;
-    int32_t water;
-    int32_t acc[3];
-    int32_t ang[3];
-    int32_t mag[3];
-    int32_t location[2];
-    uint8_t hasGPS;
-    uint32_t accumulateCount;
-}Ensemble10_eventData_t;
-
-typedef struct Ensemble07_eventData_
+    typedef Ensemble10_eventData_t Accumulator;
+    typedef Ensemble11_data_t Record;
+    static constexpr uint32_t measurementsToAccumulate = RIDE_IMU_SAMPLES_PER_ENSEMBLE;
+    static constexpr uint32_t ensembleInterval = RIDE_IMU_SAMPLE_INTERVAL_MS;
+    static constexpr SCH_OverrunPolicy_e overrunPolicy = SCH_OVERRUN_SKIP;
+    static constexpr uint8_t usesSnapshot = 1;
+    static constexpr uint8_t priority = 3;
+    static constexpr uint32_t relativeDeadline = RIDE_IMU_SAMPLE_DEADLINE_MS;
+    static void execute(Accumulator& accumulator, DeploymentSchedule_t* pDeployment);
+};
+static_assert(RIDE_Ensemble10::measurementsToAccumulate <= Ensemble10_eventData_t::maxSamples,
+    "ensemble 10 IMU sums overflow");
+static_assert(sizeof(int16_t) + Ensemble10_eventData_t::meansSize + 3 * sizeof(int16_t) == sizeof(Ensemble10_data_t),
+    "ensemble 10 fields do not match Ensemble10_data_t");
+static_assert(RIDE_Ensemble10::measurementsToAccumulate * RIDE_Ensemble10::ensembleInterval == 1000,
+    "ensemble 10 must record at 1 Hz");
+
+/**
+ * @brief Ensemble 07 - Battery every 10 seconds
+ * 
+ */
+struct RIDE_Ensemble07 : SCH_EnsembleDefaults
 {
-    float battVoltage;
-    uint32_t accumulateCount;
-}Ensemble07_eventData_t;
+    typedef Ensemble07_eventData_t Accumulator;
+    typedef Ensemble07_data_t Record;
+    static constexpr uint32_t ensembleInterval = 10000;
+    static constexpr SCH_OverrunPolicy_e overrunPolicy = SCH_OVERRUN_REPHASE;
+    static constexpr uint8_t priority = 1;
+    static void execute(Accumulator& accumulator, DeploymentSchedule_t* pDeployment);
+};
 
-typedef struct Ensemble08_eventData_
+/**
+ * @brief Ensemble 08 - Temperature once at the start of the session
+ * 
+ */
+struct RIDE_Ensemble08 : SCH_EnsembleDefaults
 {
-    double temperature;
-    int32_t water;
+    typedef Ensemble08_eventData_t Accumulator;
+    typedef Ensemble08_data_t Record;
+    static constexpr uint8_t usesSnapshot = 1;
+    static constexpr uint8_t priority = 1;
+    static void execute(Accumulator& accumulator, DeploymentSchedule_t* pDeployment);
+};
 
-    uint32_t accumulateCount;
-}Ensemble08_eventData_t;
+/**
+ * @brief Ensemble 12 - Storage forecast every SF_STORAGE_FORECAST_INTERVAL_MS
+ * 
+ * The first forecast is a full interval into the ride, so that the rate is
+ * measured rather than estimated.
+ */
+struct RIDE_Ensemble12 : SCH_EnsembleDefaults
+{
+    typedef SCH_NoAccumulator_t Accumulator;
+    typedef Ensemble12_data_t Record;
+    static constexpr uint32_t ensembleDelay = RIDE_STORAGE_FORECAST_INTERVAL_MS;
+    static constexpr uint32_t ensembleInterval = RIDE_STORAGE_FORECAST_INTERVAL_MS;
+    static constexpr SCH_OverrunPolicy_e overrunPolicy = SCH_OVERRUN_REPHASE;
+    static constexpr uint8_t priority = 1;
+    static void execute(Accumulator& accumulator, DeploymentSchedule_t* pDeployment);
+};
+static_assert(RIDE_STORAGE_FORECAST_INTERVAL_MS >= REC_FORECAST_MIN_MS,
+    "ensemble 12 would not measure the rate");
 
-static Ensemble10_eventData_t ensemble10Data;
-static Ensemble07_eventData_t ensemble07Data;
-static Ensemble08_eventData_t ensemble08Data;
+/**
+ * @brief Text ensemble - Firmware version once at the start of the session
+ * 
+ */
+struct RIDE_FwVersion : SCH_EnsembleDefaults
+{
+    typedef SCH_NoAccumulator_t Accumulator;
+    typedef RIDE_FwVersion_data_t Record;
+    static void execute(Accumulator& accumulator, DeploymentSchedule_t* pDeployment);
+};
 
 DeploymentSchedule_t deploymentSchedule[] = 
 {
-    {&SS_ensemble10Func, &SS_ensemble10Init, 1, 0, 1000, UINT32_MAX, 0, 0, 0, &ensemble10Data},
-    {&SS_ensemble07Func, &SS_ensemble07Init, 1, 0, 10000, UINT32_MAX, 0, 0, 0, &ensemble07Data},
-    {&SS_ensemble08Func, &SS_ensemble08Init, 1, 0, UINT32_MAX, UINT32_MAX, 0, 0, 0, &ensemble08Data},
-    {&SS_fwVerFunc, &SS_fwVerInit, 1, 0, UINT32_MAX, UINT32_MAX, 0, 0, 0, NULL},
-    {NULL, NULL, 0, 0, 0, 0, 0, 0, 0, NULL}
+    SCH_ensembleEntry<RIDE_Ensemble10>(),
+    SCH_ensembleEntry<RIDE_Ensemble07>(),
+    SCH_ensembleEntry<RIDE_Ensemble08>(),
+    SCH_ensembleEntry<RIDE_FwVersion>(),
+    SCH_ensembleEntry<RIDE_Ensemble12>(),
+    SCH_END_OF_SCHEDULE
 };
+SCH_CHECK_SCHEDULE_LENGTH(deploymentSchedule);
+
+static SCH_EventQueue_t deploymentQueue;
 
+RIDE_SensorSnapshot_t RIDE_snapshot;
 
+void RIDE_acquireSnapshot(system_tick_t tickTime)
+{
+    RIDE_snapshot.tickTime = tickTime;
+    RIDE_snapshot.timestamp = millis();
+    RIDE_snapshot.temperature = pSystemDesc->pTempSensor->getTemp();
+    RIDE_snapshot.water = pSystemDesc->pWaterSensor->getCurrentReading();
+}
+
+
+
+size_t RIDE_getExpectedLength(void)
+{
+    return (uint64_t) SCH_getRecordBytes(deploymentSchedule, SF_REC_PREALLOCATE_MIN * 60 * 1000) *
+        REC_STORED_PERCENT / 100;
+}
+
+int RIDE_getStorageForecast(REC_StorageForecast_t* pForecast)
+{
+    // an hour, so that the ensembles recorded once count for little
+    uint32_t recordBytesPerMinute = SCH_getRecordBytes(deploymentSchedule, 60 * 60 * 1000) / 60;
+
+    return pSystemDesc->pRecorder->getStorageForecast(pForecast, recordBytesPerMinute);
+}
 
 void RideInitTask::init(void)
 {
@@ -95,7 +194,14 @@ void RideInitTask::init(void)
 
 }
 
-static void RIDE_setFileName(system_tick_t startTime)
+/**
+ * @brief Names the session from the GPS time of its start
+ * 
+ * @param startTime Session start time
+ * @return int 1 if the GPS time is valid and the session was named,
+ * otherwise 0
+ */
+static int RIDE_setFileName(system_tick_t startTime)
 {
     char depName[REC_SESSION_NAME_MAX_LEN + 1];
     TinyGPSDate gpsDate;
@@ -124,7 +230,9 @@ static void RIDE_setFileName(system_tick_t startTime)
             sTime->tm_min, sTime->tm_sec);
         pSystemDesc->pRecorder->setSessionName(depName);
         SF_OSAL_printf("Filename is %s\n", depName);
+        return 1;
     }
+    return 0;
 }
 
 STATES_e RideInitTask::run(void)
@@ -192,9 +300,15 @@ void RideInitTask::exit(void)
 void RideTask::init(void)
 {
     SF_OSAL_printf("Entering STATE_DEPLOYED\n");
+    // open first, so garbage collecting for the session does not delay the schedule
+    pSystemDesc->pRecorder->openSession(NULL, RIDE_getExpectedLength());
     this->startTime = millis();
+    this->nameSet = false;
     SCH_initializeSchedule(deploymentSchedule, this->startTime);
-    pSystemDesc->pRecorder->openSession(NULL);
+    SCH_initializeQueue(&deploymentQueue, deploymentSchedule);
+    SCH_setAcquisition(&deploymentQueue, &RIDE_acquireSnapshot, RIDE_SNAPSHOT_WINDOW_MS);
+    SCH_setDispatchMode(&deploymentQueue, SCH_DISPATCH_EDF);
+    SCH_resetIdleStats();
 
     // initialize sensors
     if(!pSystemDesc->pIMU->open())
@@ -227,7 +341,11 @@ STATES_e RideTask::run(void)
             pSystemDesc->pGPS->encode(GPS_getch());
         }
 
-        RIDE_setFileName(this->startTime);
+        // name the session once, the name does not change with later fixes
+        if(!this->nameSet)
+        {
+            this->nameSet = RIDE_setFileName(this->startTime);
+        }
 
         if((pSystemDesc->pGPS->location.age() < GPS_AGE_VALID_MS) && (pSystemDesc->pGPS->location.age() >= 0))
         {
@@ -252,14 +370,20 @@ STATES_e RideTask::run(void)
             this->ledStatus.setActive();
         }
         
-        SCH_getNextEvent(deploymentSchedule, &pNextEvent, &nextEventTime);
-        while(millis() < nextEventTime)
+        SCH_peekNextEvent(&deploymentQueue, &pNextEvent, &nextEventTime);
+        if(pNextEvent)
         {
-            continue;
+            while(millis() < nextEventTime)
+            {
+                // the GPS streams into Serial5, so don't go deeper than delay
+                SCH_idle(nextEventTime, SCH_IDLE_DELAY);
+                while(GPS_kbhit())
+                {
+                    pSystemDesc->pGPS->encode(GPS_getch());
+                }
+            }
+            SCH_executeNextEvent(&deploymentQueue);
         }
-        pNextEvent->func(pNextEvent);
-        pNextEvent->lastExecuteTime = nextEventTime;
-        pNextEvent->measurementCount++;
 
         if(pSystemDesc->pWaterSensor->getLastStatus() == WATER_SENSOR_LOW_STATE)
         {
@@ -279,6 +403,7 @@ STATES_e RideTask::run(void)
 void RideTask::exit(void)
 {
     SF_OSAL_printf("Closing session\n");
+    SCH_logStats(deploymentSchedule);
     pSystemDesc->pRecorder->closeSession();
     // Deinitialize sensors
     pSystemDesc->pTempSensor->stop();
@@ -288,27 +413,9 @@ void RideTask::exit(void)
 
 }
 
-static void SS_ensemble10Init(DeploymentSchedule_t* pDeployment)
-{
-    memset(&ensemble10Data, 0, sizeof(Ensemble10_eventData_t));
-    pDeployment->pData = &ensemble10Data;
-}
-
-static void SS_ensemble07Init(DeploymentSchedule_t* pDeployment)
-{
-    memset(&ensemble07Data, 0, sizeof(Ensemble07_eventData_t));
-    pDeployment->pData = &ensemble07Data;
-}
-
-static void SS_ensemble08Init(DeploymentSchedule_t* pDeployment)
-{
-    memset(&ensemble08Data, 0, sizeof(Ensemble08_eventData_t));
-    pDeployment->pData = &ensemble08Data;
-}
-static void SS_ensemble10Func(DeploymentSchedule_t* pDeployment)
+void RIDE_Ensemble10::execute(Accumulator& accumulator, DeploymentSchedule_t* pDeployment)
 {
-    float temp;
-    uint8_t water;
+    int16_t rawTemp;
     int32_t lat, lng;
     uint16_t accelRawData[3];
     uint16_t gyroRawData[3];
@@ -316,198 +423,153 @@ static void SS_ensemble10Func(DeploymentSchedule_t* pDeployment)
     float accelData[3];
     float gyroData[3];
     int16_t magData[3];
-    bool hasGPS = false;
-    Ensemble10_eventData_t* pData = (Ensemble10_eventData_t*)pDeployment->pData;
-
-    #pragma pack(push, 1)
-    struct
-    {
-        EnsembleHeader_t header;
-        union{
-            Ensemble10_data_t ens10;
-            Ensemble11_data_t ens11;
-        }data;
-    }ensData;
-    #pragma pack(pop)
-
-
-    // Obtain measurements    
-    temp = pSystemDesc->pTempSensor->getTemp();
-    water = pSystemDesc->pWaterSensor->getCurrentReading();
+    bool hasGPS;
+    uint8_t* pBuffer;
 
+    // Sample the IMU every execution
     pSystemDesc->pIMU->get_accelerometer(accelData, accelData + 1, accelData + 2);
     pSystemDesc->pIMU->get_accel_raw_data((uint8_t*) accelRawData);
 
     pSystemDesc->pIMU->get_gyroscope(gyroData, gyroData + 1, gyroData + 2);
     pSystemDesc->pIMU->get_gyro_raw_data((uint8_t*) gyroRawData);
-    
-    pSystemDesc->pCompass->read(magData, magData + 1, magData + 2);
-    pSystemDesc->pCompass->read((uint8_t*) magRawData);
 
-    if(pSystemDesc->pGPS->location.isValid() && pSystemDesc->pGPS->location.isUpdated() && (pSystemDesc->pGPS->location.age() < GPS_AGE_VALID_MS))
+    // Accumulate as signed values, so that the mean is correct across zero
+    accumulator.add((int16_t) B_TO_N_ENDIAN_2(accelRawData[0]),
+        (int16_t) B_TO_N_ENDIAN_2(accelRawData[1]),
+        (int16_t) B_TO_N_ENDIAN_2(accelRawData[2]),
+        (int16_t) B_TO_N_ENDIAN_2(gyroRawData[0]),
+        (int16_t) B_TO_N_ENDIAN_2(gyroRawData[1]),
+        (int16_t) B_TO_N_ENDIAN_2(gyroRawData[2]));
+
+    if(accumulator.getCount() < measurementsToAccumulate)
     {
-        hasGPS = true;
-        lat = pSystemDesc->pGPS->location.lat_int32();
-        lng = pSystemDesc->pGPS->location.lng_int32();
+        return;
     }
-    else
+
+    // The slow sensors are read once per record.  The scheduler acquires the
+    // snapshot for this sample only.
+    rawTemp = RIDE_snapshot.temperature / RIDE_TEMP_RESOLUTION;
+    if(!RIDE_snapshot.water)
     {
-        hasGPS = false;
-        lat = pData->location[0];
-        lng = pData->location[1];
+        rawTemp += RIDE_TEMP_DRY_OFFSET;
     }
 
-    // Accumulate measurements
-    pData->temperature += temp;
-    pData->water += water;
-    pData->acc[0] += B_TO_N_ENDIAN_2(accelRawData[0]);
-    pData->acc[1] += B_TO_N_ENDIAN_2(accelRawData[1]);
-    pData->acc[2] += B_TO_N_ENDIAN_2(accelRawData[2]);
-    pData->ang[0] += B_TO_N_ENDIAN_2(gyroRawData[0]);
-    pData->ang[1] += B_TO_N_ENDIAN_2(gyroRawData[1]);
-    pData->ang[2] += B_TO_N_ENDIAN_2(gyroRawData[2]);
-    pData->mag[0] += B_TO_N_ENDIAN_2(magRawData[0]);
-    pData->mag[1] += B_TO_N_ENDIAN_2(magRawData[1]);
-    pData->mag[2] += B_TO_N_ENDIAN_2(magRawData[2]);
-    pData->location[0] += lat;
-    pData->location[1] += lng;
-    pData->hasGPS += hasGPS ? 1 : 0;
-    pData->accumulateCount++;
+    pSystemDesc->pCompass->read(magData, magData + 1, magData + 2);
+    pSystemDesc->pCompass->read((uint8_t*) magRawData);
 
+    hasGPS = pSystemDesc->pGPS->location.isValid() && pSystemDesc->pGPS->location.isUpdated() && (pSystemDesc->pGPS->location.age() < GPS_AGE_VALID_MS);
+    if(hasGPS)
+    {
+        lat = pSystemDesc->pGPS->location.lat_int32();
+        lng = pSystemDesc->pGPS->location.lng_int32();
+    }
 
     // Report accumulated measurements
-    if(pData->accumulateCount == pDeployment->measurementsToAccumulate)
+    pBuffer = (uint8_t*) pSystemDesc->pRecorder->reserveBytes(sizeof(EnsembleHeader_t) + 
+        (hasGPS ? sizeof(Ensemble11_data_t) : sizeof(Ensemble10_data_t)));
+    if(pBuffer)
     {
-        water = pData->water / pDeployment->measurementsToAccumulate;
-        temp = pData->temperature / pDeployment->measurementsToAccumulate;
-        if(water == false)
-        {
-            temp -= 100;
-        }
-        
-
-        ensData.header.elapsedTime_ds = Ens_getStartTime(pDeployment->startTime);
-        SF_OSAL_printf("Ensemble timestamp: %d\n", ensData.header.elapsedTime_ds);
-        ensData.data.ens10.rawTemp = N_TO_B_ENDIAN_2(temp / 0.0078125);
-        ensData.data.ens10.rawAcceleration[0] = N_TO_B_ENDIAN_2(pData->acc[0] / pDeployment->measurementsToAccumulate);
-        ensData.data.ens10.rawAcceleration[1] = N_TO_B_ENDIAN_2(pData->acc[1] / pDeployment->measurementsToAccumulate);
-        ensData.data.ens10.rawAcceleration[2] = N_TO_B_ENDIAN_2(pData->acc[2] / pDeployment->measurementsToAccumulate);
-        ensData.data.ens10.rawAngularVel[0] = N_TO_B_ENDIAN_2(pData->ang[0] / pDeployment->measurementsToAccumulate);
-        ensData.data.ens10.rawAngularVel[1] = N_TO_B_ENDIAN_2(pData->ang[1] / pDeployment->measurementsToAccumulate);
-        ensData.data.ens10.rawAngularVel[2] = N_TO_B_ENDIAN_2(pData->ang[2] / pDeployment->measurementsToAccumulate);
-        ensData.data.ens10.rawMagField[0] = N_TO_B_ENDIAN_2(pData->mag[0] / pDeployment->measurementsToAccumulate);
-        ensData.data.ens10.rawMagField[1] = N_TO_B_ENDIAN_2(pData->mag[1] / pDeployment->measurementsToAccumulate);
-        ensData.data.ens10.rawMagField[2] = N_TO_B_ENDIAN_2(pData->mag[2] / pDeployment->measurementsToAccumulate);
-        ensData.data.ens11.location[0] = N_TO_B_ENDIAN_4(pData->location[0] / pDeployment->measurementsToAccumulate);
-        ensData.data.ens11.location[1] = N_TO_B_ENDIAN_4(pData->location[1] / pDeployment->measurementsToAccumulate);
-
-        if(pData->hasGPS / pDeployment->measurementsToAccumulate)
+        pBuffer = Ens_putHeader(pBuffer, hasGPS ? ENS_TEMP_IMU_GPS : ENS_TEMP_IMU, pDeployment->startTime);
+        pBuffer = Ens_putBigEndian(pBuffer, rawTemp);
+        pBuffer = accumulator.putMeans(pBuffer);
+        // the compass registers are already big-endian
+        memcpy(pBuffer, magRawData, sizeof(magRawData));
+        pBuffer += sizeof(magRawData);
+        if(hasGPS)
         {
-            ensData.header.ensembleType = ENS_TEMP_IMU_GPS;
-            pSystemDesc->pRecorder->putBytes(&ensData, sizeof(EnsembleHeader_t) + sizeof(Ensemble11_data_t));
+            pBuffer = Ens_putBigEndian(pBuffer, lat);
+            pBuffer = Ens_putBigEndian(pBuffer, lng);
         }
-        else
-        {
-            ensData.header.ensembleType = ENS_TEMP_IMU;
-            pSystemDesc->pRecorder->putBytes(&ensData, sizeof(EnsembleHeader_t) + sizeof(Ensemble10_data_t));
-        }
-        
-        memset(pData, 0, sizeof(Ensemble10_eventData_t));
     }
+    accumulator.reset();
 }
 
-static void SS_ensemble07Func(DeploymentSchedule_t* pDeployment)
+void RIDE_Ensemble07::execute(Accumulator& accumulator, DeploymentSchedule_t* pDeployment)
 {
-    float battVoltage;
-    Ensemble07_eventData_t* pData = (Ensemble07_eventData_t*) pDeployment->pData;
-    #pragma pack(push, 1)
-    struct{
-        EnsembleHeader_t header;
-        Ensemble07_data_t data;
-    }ensData;
-    #pragma pack(pop)
-
-    // obtain measurements
-    battVoltage = pSystemDesc->pBattery->getVCell();
+    uint8_t* pBuffer;
 
-    // accumulate measurements
-    pData->battVoltage += battVoltage;
-    pData->accumulateCount++;
+    // obtain and accumulate measurements
+    accumulator.add(pSystemDesc->pBattery->getVCell() * 1000);
 
     // Report accumulated measurements
-    if(pData->accumulateCount == pDeployment->measurementsToAccumulate)
+    if(accumulator.getCount() == measurementsToAccumulate)
     {
-        ensData.header.elapsedTime_ds = Ens_getStartTime(pDeployment->startTime);
-        ensData.header.ensembleType = ENS_BATT;
-        ensData.data.batteryVoltage = N_TO_B_ENDIAN_2((pData->battVoltage / pData->accumulateCount) * 1000);
-
-        pSystemDesc->pRecorder->putData(ensData);
-        memset(pData, 0, sizeof(Ensemble07_eventData_t));
+        pBuffer = (uint8_t*) pSystemDesc->pRecorder->reserveBytes(sizeof(EnsembleHeader_t) + sizeof(Ensemble07_data_t));
+        if(pBuffer)
+        {
+            pBuffer = Ens_putHeader(pBuffer, ENS_BATT, pDeployment->startTime);
+            accumulator.putMeans(pBuffer);
+        }
+        accumulator.reset();
     }
-
 }
 
-static void SS_ensemble08Func(DeploymentSchedule_t* pDeployment)
+void RIDE_Ensemble08::execute(Accumulator& accumulator, DeploymentSchedule_t* pDeployment)
 {
-    float temp;
-    uint8_t water;
-
-    Ensemble08_eventData_t* pData = (Ensemble08_eventData_t*) pDeployment->pData;
-    #pragma pack(push, 1)
-    struct{
-        EnsembleHeader_t header;
-        Ensemble08_data_t ensData;
-    }ens;
-    #pragma pack(pop)
+    int16_t rawTemp;
+    uint8_t* pBuffer;
 
-    // obtain measurements
-    temp = pSystemDesc->pTempSensor->getTemp();
-    water = pSystemDesc->pWaterSensor->getCurrentReading();
-
-    // accumulate measurements
-    pData->temperature += temp;
-    pData->water += water;
-    pData->accumulateCount++;
+    // obtain and accumulate measurements
+    accumulator.add(RIDE_snapshot.temperature / RIDE_TEMP_RESOLUTION, RIDE_snapshot.water);
 
     // Report accumulated measurements
-    if(pData->accumulateCount == pDeployment->measurementsToAccumulate)
+    if(accumulator.getCount() == measurementsToAccumulate)
     {
-        water = pData->water / pDeployment->measurementsToAccumulate;
-        temp = pData->temperature / pDeployment->measurementsToAccumulate;
-        if(water == false)
+        rawTemp = accumulator.getMean<0>();
+        if(!accumulator.getMean<1>())
         {
-            temp -= 100;
+            rawTemp += RIDE_TEMP_DRY_OFFSET;
         }
-        
-        
-        ens.header.elapsedTime_ds = Ens_getStartTime(pDeployment->startTime);
-        ens.header.ensembleType = ENS_TEMP_TIME;
-        ens.ensData.rawTemp = N_TO_B_ENDIAN_2(temp / 0.0078125);
 
-        pSystemDesc->pRecorder->putData(ens);
-        memset(pData, 0, sizeof(Ensemble08_eventData_t));
+        pBuffer = (uint8_t*) pSystemDesc->pRecorder->reserveBytes(sizeof(EnsembleHeader_t) + sizeof(Ensemble08_data_t));
+        if(pBuffer)
+        {
+            pBuffer = Ens_putHeader(pBuffer, ENS_TEMP_TIME, pDeployment->startTime);
+            pBuffer = Ens_putBigEndian(pBuffer, rawTemp);
+            // timestamp is not used
+            pBuffer = Ens_putBigEndian<uint32_t>(pBuffer, 0);
+        }
+        accumulator.reset();
     }
-
 }
 
-static void SS_fwVerInit(DeploymentSchedule_t* pDeployment)
-{
-    (void) pDeployment;
-}
-static void SS_fwVerFunc(DeploymentSchedule_t* pDeployment)
+void RIDE_FwVersion::execute(Accumulator& accumulator, DeploymentSchedule_t* pDeployment)
 {
+    (void) accumulator;
 #pragma pack(push, 1)
     struct textEns{
         EnsembleHeader_t header;
-        uint8_t nChars;
-        char verBuf[32];
+        Record data;
     } ens;
 #pragma pack(pop)
 
     ens.header.elapsedTime_ds = Ens_getStartTime(pDeployment->startTime);
     ens.header.ensembleType = ENS_TEXT;
 
-    ens.nChars = snprintf(ens.verBuf, 32, "FW%d.%d.%d%s", FW_MAJOR_VERSION, FW_MINOR_VERSION, FW_BUILD_NUM, FW_BRANCH);
-    pSystemDesc->pRecorder->putBytes(&ens, sizeof(EnsembleHeader_t) + sizeof(uint8_t) + ens.nChars);
+    ens.data.nChars = snprintf(ens.data.verBuf, sizeof(ens.data.verBuf), "FW%d.%d.%d%s", FW_MAJOR_VERSION, FW_MINOR_VERSION, FW_BUILD_NUM, FW_BRANCH);
+    pSystemDesc->pRecorder->putBytes(&ens, sizeof(EnsembleHeader_t) + sizeof(uint8_t) + ens.data.nChars);
+
+}
+
+void RIDE_Ensemble12::execute(Accumulator& accumulator, DeploymentSchedule_t* pDeployment)
+{
+    REC_StorageForecast_t forecast;
+    uint8_t* pBuffer;
 
+    (void) accumulator;
+    if(!RIDE_getStorageForecast(&forecast))
+    {
+        return;
+    }
+
+    pBuffer = (uint8_t*) pSystemDesc->pRecorder->reserveBytes(sizeof(EnsembleHeader_t) + sizeof(Ensemble12_data_t));
+    if(pBuffer)
+    {
+        pBuffer = Ens_putHeader(pBuffer, ENS_STORAGE, pDeployment->startTime);
+        pBuffer = Ens_putBigEndian(pBuffer, RIDE_saturate16((forecast.totalBytes - forecast.usedBytes) / 1024));
+        pBuffer = Ens_putBigEndian(pBuffer, RIDE_saturate16(forecast.bytesPerMinute));
+        pBuffer = Ens_putBigEndian(pBuffer, RIDE_saturate16(forecast.minutesRemaining));
+        pBuffer = Ens_putBigEndian<uint8_t>(pBuffer, forecast.paddingPercent);
+        pBuffer = Ens_putBigEndian<uint8_t>(pBuffer, forecast.measured);
+    }
 }
@@ -4,6 +4,8 @@
 
 #include "Particle.h"
 #include "product.hpp"
+#include "recorder.hpp"
+#include "scheduler.hpp"
 
 #define RIDE_RGB_LED_COLOR    RGB_COLOR_WHITE
 #define RIDE_RGB_LED_PATTERN_GPS  LED_PATTERN_BLINK
@@ -17,6 +19,70 @@
 
 #define RIDE_INIT_WATER_TIMEOUT_MS  SURF_SESSION_GET_INTO_WATER_TIMEOUT_MS
 
+#define RIDE_SNAPSHOT_WINDOW_MS SF_SENSOR_SNAPSHOT_WINDOW_MS
+
+/**
+ * @brief Resolution of recorded temperatures in degrees C
+ * 
+ */
+#define RIDE_TEMP_RESOLUTION    0.0078125
+/**
+ * @brief Offset added to raw temperatures recorded out of the water (-100 C)
+ * 
+ */
+#define RIDE_TEMP_DRY_OFFSET    ((int16_t) (-100 / RIDE_TEMP_RESOLUTION))
+
+#define RIDE_IMU_SAMPLE_INTERVAL_MS SF_IMU_SAMPLE_INTERVAL_MS
+#define RIDE_IMU_SAMPLES_PER_ENSEMBLE   SF_IMU_SAMPLES_PER_ENSEMBLE
+#define RIDE_IMU_SAMPLE_DEADLINE_MS SF_IMU_SAMPLE_DEADLINE_MS
+#define RIDE_STORAGE_FORECAST_INTERVAL_MS   SF_STORAGE_FORECAST_INTERVAL_MS
+
+/**
+ * @brief Shared sensor reading for all ensembles due on the same tick
+ * 
+ */
+typedef struct RIDE_SensorSnapshot_
+{
+    /**
+     * @brief Scheduled time of the tick the snapshot was taken for
+     * 
+     */
+    system_tick_t tickTime;
+    /**
+     * @brief millis() when the sensors were read
+     * 
+     */
+    system_tick_t timestamp;
+    float temperature;
+    uint8_t water;
+}RIDE_SensorSnapshot_t;
+
+extern DeploymentSchedule_t deploymentSchedule[];
+extern RIDE_SensorSnapshot_t RIDE_snapshot;
+
+/**
+ * @brief Reads the temperature and water sensors into RIDE_snapshot
+ * 
+ * @param tickTime Scheduled time of the tick
+ */
+void RIDE_acquireSnapshot(system_tick_t tickTime);
+
+/**
+ * @brief Returns the most file system bytes a ride of SF_REC_PREALLOCATE_MIN
+ * minutes uses
+ * 
+ * @return size_t Bytes of records, after encoding and compression
+ */
+size_t RIDE_getExpectedLength(void);
+
+/**
+ * @brief Projects how many minutes of riding the file system has left
+ * 
+ * @param pForecast Forecast to fill
+ * @return int 1 if successful, otherwise 0
+ */
+int RIDE_getStorageForecast(REC_StorageForecast_t* pForecast);
+
 class RideInitTask : public Task
 {
     public:
@@ -38,6 +104,11 @@ class RideTask : public Task
     private:
     LEDStatus ledStatus;
     bool gpsLocked;
+    /**
+     * @brief The session has been named from the GPS time
+     * 
+     */
+    bool nameSet;
     system_tick_t startTime;
 
 };
@@ -0,0 +1,195 @@
+#ifndef __SCHEDULE_TABLE_HPP__
+#define __SCHEDULE_TABLE_HPP__
+/**
+ * @brief Compile-time checked schedule table entries
+ *
+ * An ensemble is declared as a struct that derives from SCH_EnsembleDefaults,
+ * overrides the parameters that differ from the defaults by name, and
+ * provides:
+ *
+ *  - Accumulator: type of the ensemble's accumulator
+ *  - Record: type of the largest data block the ensemble records, without
+ *    the ensemble header
+ *  - static void execute(Accumulator& accumulator, DeploymentSchedule_t* pDeployment)
+ *
+ * SCH_ensembleEntry<Ensemble>() then builds the schedule table entry, owns
+ * the accumulator, and rejects inconsistent parameters at compile time:
+ *
+ *     struct RIDE_Battery : SCH_EnsembleDefaults
+ *     {
+ *         typedef Ensemble07_eventData_t Accumulator;
+ *         typedef Ensemble07_data_t Record;
+ *         static constexpr uint32_t ensembleInterval = 10000;
+ *         static void execute(Accumulator& accumulator, DeploymentSchedule_t* pDeployment);
+ *     };
+ *
+ *     DeploymentSchedule_t schedule[] =
+ *     {
+ *         SCH_ensembleEntry<RIDE_Battery>(),
+ *         SCH_END_OF_SCHEDULE
+ *     };
+ *     SCH_CHECK_SCHEDULE_LENGTH(schedule);
+ *
+ * Entries are constant expressions, so tables built this way are statically
+ * initialized like the positional tables.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "ensembleTypes.hpp"
+#include "recorder.hpp"
+#include "scheduler.hpp"
+
+/**
+ * @brief Default ensemble parameters
+ *
+ */
+struct SCH_EnsembleDefaults
+{
+    /**
+     * @brief Number of measurements per recorded ensemble
+     *
+     */
+    static constexpr uint32_t measurementsToAccumulate = 1;
+    /**
+     * @brief Delay from the start of the deployment to the first measurement
+     * in ms
+     *
+     */
+    static constexpr uint32_t ensembleDelay = 0;
+    /**
+     * @brief Interval between measurements in ms, UINT32_MAX to measure once
+     *
+     */
+    static constexpr uint32_t ensembleInterval = UINT32_MAX;
+    /**
+     * @brief Total number of measurements, UINT32_MAX to measure forever
+     *
+     */
+    static constexpr uint32_t nMeasurements = UINT32_MAX;
+    static constexpr SCH_OverrunPolicy_e overrunPolicy = SCH_OVERRUN_CATCH_UP;
+    static constexpr uint8_t usesSnapshot = 0;
+    static constexpr uint8_t priority = 0;
+    /**
+     * @brief Relative deadline in ms, 0 to use the interval
+     *
+     */
+    static constexpr uint32_t relativeDeadline = 0;
+};
+
+/**
+ * @brief Accumulator for ensembles that do not accumulate
+ *
+ */
+typedef struct SCH_NoAccumulator_
+{
+    uint8_t unused;
+}SCH_NoAccumulator_t;
+
+/**
+ * @brief Binds an ensemble declaration to the scheduler
+ *
+ * @tparam Ensemble Ensemble declaration
+ */
+template <class Ensemble> class SCH_Ensemble
+{
+    public:
+    typedef typename Ensemble::Accumulator Accumulator;
+
+    static_assert(Ensemble::ensembleInterval > 0,
+        "ensemble interval must be nonzero");
+    static_assert(Ensemble::measurementsToAccumulate > 0,
+        "ensemble must accumulate at least one measurement");
+    static_assert(Ensemble::ensembleInterval != UINT32_MAX ||
+        Ensemble::measurementsToAccumulate == 1,
+        "single shot ensemble cannot accumulate more than one measurement");
+    static_assert(Ensemble::ensembleInterval == UINT32_MAX ||
+        Ensemble::measurementsToAccumulate <= UINT32_MAX / Ensemble::ensembleInterval,
+        "ensemble accumulation period overflows");
+    static_assert(Ensemble::nMeasurements == UINT32_MAX ||
+        Ensemble::nMeasurements % Ensemble::measurementsToAccumulate == 0,
+        "ensemble would stop with a partially accumulated record");
+    static_assert(Ensemble::relativeDeadline <= Ensemble::ensembleInterval,
+        "ensemble deadline is longer than its interval");
+    static_assert(sizeof(EnsembleHeader_t) + sizeof(typename Ensemble::Record) <= REC_MAX_RECORD_SIZE,
+        "ensemble record does not fit in a packet");
+
+    /**
+     * @brief Clears the accumulator
+     *
+     * @param pDeployment Schedule entry
+     */
+    static void init(DeploymentSchedule_t* pDeployment)
+    {
+        memset(&SCH_Ensemble::accumulator, 0, sizeof(Accumulator));
+        pDeployment->pData = &SCH_Ensemble::accumulator;
+    }
+
+    /**
+     * @brief Runs the ensemble with its typed accumulator
+     *
+     * Ensemble::execute is inlined here, so the scheduler's call through the
+     * entry is the only indirect call.
+     *
+     * @param pDeployment Schedule entry
+     */
+    static void execute(DeploymentSchedule_t* pDeployment)
+    {
+        Ensemble::execute(SCH_Ensemble::accumulator, pDeployment);
+    }
+
+    static Accumulator accumulator;
+};
+
+template <class Ensemble> typename SCH_Ensemble<Ensemble>::Accumulator SCH_Ensemble<Ensemble>::accumulator;
+
+/**
+ * @brief Builds a schedule table entry for an ensemble
+ *
+ * @tparam Ensemble Ensemble declaration
+ * @return DeploymentSchedule_t Schedule table entry
+ */
+template <class Ensemble> constexpr DeploymentSchedule_t SCH_ensembleEntry(void)
+{
+    return DeploymentSchedule_t{
+        &SCH_Ensemble<Ensemble>::execute,
+        &SCH_Ensemble<Ensemble>::init,
+        Ensemble::measurementsToAccumulate,
+        Ensemble::ensembleDelay,
+        Ensemble::ensembleInterval,
+        Ensemble::nMeasurements,
+        0,
+        0,
+        0,
+        &SCH_Ensemble<Ensemble>::accumulator,
+        Ensemble::overrunPolicy,
+        Ensemble::usesSnapshot,
+        Ensemble::priority,
+        Ensemble::relativeDeadline,
+        sizeof(EnsembleHeader_t) + sizeof(typename Ensemble::Record),
+        0,
+        0,
+        0,
+        0,
+        0,
+        SCH_Histogram_t{{}, 0},
+        SCH_Histogram_t{{}, 0}
+    };
+}
+
+/**
+ * @brief Schedule table terminator
+ *
+ */
+#define SCH_END_OF_SCHEDULE {NULL, NULL, 0, 0, 0, 0, 0, 0, 0, NULL, SCH_OVERRUN_CATCH_UP, 0, 0, 0, 0, \
+    0, 0, 0, 0, 0, {{}, 0}, {{}, 0}}
+
+/**
+ * @brief Checks that a schedule table fits in the event queue
+ *
+ */
+#define SCH_CHECK_SCHEDULE_LENGTH(schedule) \
+    static_assert(sizeof(schedule) / sizeof(schedule[0]) - 1 <= SCH_MAX_SCHEDULE_LEN, \
+        #schedule " has more entries than the event queue holds")
+
+#endif
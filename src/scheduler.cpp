@@ -1,5 +1,38 @@
 #include "scheduler.hpp"
 #include "conio.hpp"
+#include "flog.hpp"
+
+static int SCH_computeNextTime(const DeploymentSchedule_t* pEvent, size_t* pNextTime);
+/**
+ * @brief Heap ordering function
+ * 
+ * @return int 1 if pA should be closer to the root than pB, otherwise 0
+ */
+typedef int (*SCH_HeapOrder)(const DeploymentSchedule_t* pA, const DeploymentSchedule_t* pB);
+
+static int SCH_isEarlier(const DeploymentSchedule_t* pA, const DeploymentSchedule_t* pB);
+static int SCH_isMoreUrgent(const DeploymentSchedule_t* pA, const DeploymentSchedule_t* pB);
+static size_t SCH_getDeadline(const DeploymentSchedule_t* pEvent);
+static void SCH_releaseEvents(SCH_EventQueue_t* pQueue, size_t now);
+static DeploymentSchedule_t* SCH_getCurrentEvent(SCH_EventQueue_t* pQueue);
+static int SCH_isDeferred(SCH_EventQueue_t* pQueue, size_t now);
+static int SCH_completesRecord(const DeploymentSchedule_t* pEvent);
+static void SCH_siftUp(DeploymentSchedule_t** pHeap, size_t idx, SCH_HeapOrder isBefore);
+static void SCH_siftDown(DeploymentSchedule_t** pHeap, size_t nEvents, size_t idx, SCH_HeapOrder isBefore);
+static void SCH_addToHistogram(SCH_Histogram_t* pHist, uint32_t value_us);
+static void SCH_displayHistogram(const char* name, const SCH_Histogram_t* pHist);
+
+/**
+ * @brief Time spent in each idle state since SCH_idleStatsStart (ms)
+ * 
+ */
+static uint32_t SCH_idleTime[SCH_IDLE_NUM_STATES];
+static system_tick_t SCH_idleStatsStart;
+/**
+ * @brief Running estimate of the ULTRA_LOW_POWER wake-up latency (ms)
+ * 
+ */
+static system_tick_t SCH_sleepLatency = SCH_IDLE_SLEEP_WAKE_LATENCY_MS;
 
 void SCH_initializeSchedule(DeploymentSchedule_t* pDeployment, system_tick_t startTime)
 {
@@ -8,10 +41,45 @@ void SCH_initializeSchedule(DeploymentSchedule_t* pDeployment, system_tick_t sta
         pDeployment->startTime = startTime;
         pDeployment->lastExecuteTime = 0;
         pDeployment->measurementCount = 0;
+        pDeployment->nextExecuteTime = 0;
+        pDeployment->missCount = 0;
+        pDeployment->totalLateness = 0;
+        pDeployment->deadlineMissCount = 0;
+        pDeployment->startMicros = micros() - (millis() - startTime) * 1000;
+        memset(&pDeployment->runtimeHist, 0, sizeof(SCH_Histogram_t));
+        memset(&pDeployment->jitterHist, 0, sizeof(SCH_Histogram_t));
         pDeployment->init(pDeployment);
     }
 }
 
+/**
+ * @brief Computes when the specified event should next execute
+ *
+ * @param pEvent Event to check
+ * @param pNextTime Set to the next execution time if the event is pending
+ * @return int 1 if the event has executions remaining, otherwise 0
+ */
+static int SCH_computeNextTime(const DeploymentSchedule_t* pEvent, size_t* pNextTime)
+{
+    if(pEvent->lastExecuteTime == 0)
+    {
+        *pNextTime = pEvent->startTime + pEvent->ensembleDelay;
+    }
+    else
+    {
+        if(pEvent->ensembleInterval == UINT32_MAX)
+        {
+            return 0;
+        }
+        *pNextTime = pEvent->lastExecuteTime + pEvent->ensembleInterval;
+    }
+    if(pEvent->measurementCount > pEvent->nMeasurements)
+    {
+        return 0;
+    }
+    return 1;
+}
+
 void SCH_getNextEvent(DeploymentSchedule_t* deploymentSchedule, DeploymentSchedule_t ** pEventPtr, size_t* pNextTime)
 {
     size_t earliestExecution = 0;
@@ -24,22 +92,7 @@ void SCH_getNextEvent(DeploymentSchedule_t* deploymentSchedule, DeploymentSchedu
 
     for(i = 0; deploymentSchedule[i].func; i++)
     {
-        if(deploymentSchedule[i].lastExecuteTime == 0)
-        {
-            timeToCompare = deploymentSchedule[i].startTime + deploymentSchedule[i].ensembleDelay;
-        }
-        else
-        {
-            if(deploymentSchedule[i].ensembleInterval != UINT32_MAX)
-            {
-                timeToCompare = deploymentSchedule[i].lastExecuteTime + deploymentSchedule[i].ensembleInterval;
-            }
-            else
-            {
-                continue;
-            }
-        }
-        if(deploymentSchedule[i].measurementCount > deploymentSchedule[i].nMeasurements)
+        if(!SCH_computeNextTime(&deploymentSchedule[i], &timeToCompare))
         {
             continue;
         }
@@ -48,6 +101,7 @@ void SCH_getNextEvent(DeploymentSchedule_t* deploymentSchedule, DeploymentSchedu
         if(earliestExecution == 0)
         {
             earliestExecution = timeToCompare;
+            earliestEvent = i;
         }
 
         if(timeToCompare < earliestExecution)
@@ -58,4 +112,619 @@ void SCH_getNextEvent(DeploymentSchedule_t* deploymentSchedule, DeploymentSchedu
     }
     *pNextTime = earliestExecution;
     *pEventPtr = deploymentSchedule + earliestEvent;
-}
\ No newline at end of file
+}
+
+int SCH_initializeQueue(SCH_EventQueue_t* pQueue, DeploymentSchedule_t* deploymentSchedule)
+{
+    size_t i;
+
+    pQueue->nEvents = 0;
+    pQueue->nReady = 0;
+    pQueue->mode = SCH_DISPATCH_TIME;
+    pQueue->pSchedule = deploymentSchedule;
+    pQueue->acquire = NULL;
+    pQueue->acquireWindow = 0;
+    pQueue->lastAcquireTime = 0;
+    pQueue->hasAcquired = 0;
+    for(i = 0; deploymentSchedule[i].func; i++)
+    {
+        if(!SCH_computeNextTime(&deploymentSchedule[i], &deploymentSchedule[i].nextExecuteTime))
+        {
+            continue;
+        }
+        if(pQueue->nEvents == SCH_MAX_SCHEDULE_LEN)
+        {
+            SF_OSAL_printf("SCH::INIT Too many events\n");
+            return 0;
+        }
+        pQueue->pHeap[pQueue->nEvents] = &deploymentSchedule[i];
+        SCH_siftUp(pQueue->pHeap, pQueue->nEvents, &SCH_isEarlier);
+        pQueue->nEvents++;
+    }
+    return 1;
+}
+
+void SCH_setAcquisition(SCH_EventQueue_t* pQueue, SCH_AcquireFunction acquire, uint32_t window)
+{
+    pQueue->acquire = acquire;
+    pQueue->acquireWindow = window;
+    pQueue->hasAcquired = 0;
+}
+
+void SCH_setDispatchMode(SCH_EventQueue_t* pQueue, SCH_DispatchMode_e mode)
+{
+    pQueue->mode = mode;
+}
+
+void SCH_peekNextEvent(SCH_EventQueue_t* pQueue, DeploymentSchedule_t** pEventPtr, size_t* pNextTime)
+{
+    DeploymentSchedule_t* pReady;
+    DeploymentSchedule_t* pPending;
+    system_tick_t now;
+
+    *pEventPtr = NULL;
+    *pNextTime = 0;
+    if(pQueue->mode != SCH_DISPATCH_EDF)
+    {
+        if(pQueue->nEvents != 0)
+        {
+            *pEventPtr = pQueue->pHeap[0];
+            *pNextTime = pQueue->pHeap[0]->nextExecuteTime;
+        }
+        return;
+    }
+
+    now = millis();
+    SCH_releaseEvents(pQueue, now);
+    pPending = (pQueue->nEvents != 0) ? pQueue->pHeap[0] : NULL;
+    if(pQueue->nReady == 0)
+    {
+        if(pPending)
+        {
+            *pEventPtr = pPending;
+            *pNextTime = pPending->nextExecuteTime;
+        }
+        return;
+    }
+
+    pReady = pQueue->pReady[0];
+    *pEventPtr = pReady;
+    *pNextTime = now;
+    if(SCH_isDeferred(pQueue, now))
+    {
+        *pEventPtr = pPending;
+        *pNextTime = pPending->nextExecuteTime;
+    }
+}
+
+void SCH_executeNextEvent(SCH_EventQueue_t* pQueue)
+{
+    DeploymentSchedule_t* pEvent;
+    system_tick_t startTime;
+    uint32_t startMicros;
+    uint32_t endMicros;
+    uint32_t jitter_us;
+
+    if(pQueue->mode == SCH_DISPATCH_EDF)
+    {
+        SCH_releaseEvents(pQueue, millis());
+        if(SCH_isDeferred(pQueue, millis()))
+        {
+            return;
+        }
+    }
+    pEvent = SCH_getCurrentEvent(pQueue);
+    if(NULL == pEvent)
+    {
+        return;
+    }
+    if(pQueue->acquire && pEvent->usesSnapshot && SCH_completesRecord(pEvent) &&
+        (!pQueue->hasAcquired ||
+        pEvent->nextExecuteTime > pQueue->lastAcquireTime + pQueue->acquireWindow))
+    {
+        pQueue->acquire(pEvent->nextExecuteTime);
+        pQueue->lastAcquireTime = pEvent->nextExecuteTime;
+        pQueue->hasAcquired = 1;
+    }
+    startTime = millis();
+    startMicros = micros();
+    pEvent->func(pEvent);
+    endMicros = micros();
+
+    // scheduled time in us, on the same time base as micros()
+    jitter_us = startMicros - (pEvent->startMicros + 
+        (uint32_t)(pEvent->nextExecuteTime - pEvent->startTime) * 1000);
+    if((int32_t) jitter_us < 0)
+    {
+        // millis() and micros() round differently
+        jitter_us = 0;
+    }
+    SCH_addToHistogram(&pEvent->jitterHist, jitter_us);
+    SCH_addToHistogram(&pEvent->runtimeHist, endMicros - startMicros);
+    SCH_rescheduleEvent(pQueue, startTime);
+}
+
+/**
+ * @brief Checks if the next execution of an event completes a record
+ * 
+ * @param pEvent Event to check
+ * @return int 1 if the next execution is the last one accumulated into a
+ * record, otherwise 0
+ */
+static int SCH_completesRecord(const DeploymentSchedule_t* pEvent)
+{
+    if(pEvent->measurementsToAccumulate <= 1)
+    {
+        return 1;
+    }
+    return (pEvent->measurementCount % pEvent->measurementsToAccumulate) == 
+        pEvent->measurementsToAccumulate - 1;
+}
+
+void SCH_rescheduleEvent(SCH_EventQueue_t* pQueue, system_tick_t startTime)
+{
+    DeploymentSchedule_t* pEvent;
+    size_t scheduledTime;
+    uint32_t lateness = 0;
+    uint32_t slotsMissed = 0;
+
+    pEvent = SCH_getCurrentEvent(pQueue);
+    if(NULL == pEvent)
+    {
+        return;
+    }
+    scheduledTime = pEvent->nextExecuteTime;
+    if(startTime > SCH_getDeadline(pEvent))
+    {
+        pEvent->deadlineMissCount++;
+    }
+    if(startTime > scheduledTime)
+    {
+        lateness = startTime - scheduledTime;
+    }
+    if(pEvent->ensembleInterval != UINT32_MAX)
+    {
+        slotsMissed = lateness / pEvent->ensembleInterval;
+    }
+
+    if(slotsMissed)
+    {
+        if(pEvent->missCount == 0)
+        {
+            FLOG_AddError(FLOG_SCH_FIRST_MISS, pEvent - pQueue->pSchedule);
+        }
+        pEvent->missCount += slotsMissed;
+    }
+    pEvent->totalLateness += lateness;
+
+    switch(pEvent->overrunPolicy)
+    {
+        default:
+        case SCH_OVERRUN_CATCH_UP:
+            pEvent->lastExecuteTime = scheduledTime;
+            break;
+        case SCH_OVERRUN_SKIP:
+            // this execution stands in for the latest slot that has passed
+            pEvent->lastExecuteTime = scheduledTime + slotsMissed * pEvent->ensembleInterval;
+            break;
+        case SCH_OVERRUN_REPHASE:
+            pEvent->lastExecuteTime = (lateness != 0) ? startTime : scheduledTime;
+            break;
+    }
+    pEvent->measurementCount++;
+
+    if(pQueue->mode == SCH_DISPATCH_EDF)
+    {
+        // move the event from the ready heap back to the pending heap
+        pQueue->nReady--;
+        pQueue->pReady[0] = pQueue->pReady[pQueue->nReady];
+        SCH_siftDown(pQueue->pReady, pQueue->nReady, 0, &SCH_isMoreUrgent);
+        if(SCH_computeNextTime(pEvent, &pEvent->nextExecuteTime))
+        {
+            pQueue->pHeap[pQueue->nEvents] = pEvent;
+            SCH_siftUp(pQueue->pHeap, pQueue->nEvents, &SCH_isEarlier);
+            pQueue->nEvents++;
+        }
+        return;
+    }
+
+    if(!SCH_computeNextTime(pEvent, &pEvent->nextExecuteTime))
+    {
+        // no executions left, replace the root with the last leaf
+        pQueue->nEvents--;
+        pQueue->pHeap[0] = pQueue->pHeap[pQueue->nEvents];
+    }
+    SCH_siftDown(pQueue->pHeap, pQueue->nEvents, 0, &SCH_isEarlier);
+}
+
+void SCH_displayStats(DeploymentSchedule_t* deploymentSchedule)
+{
+    static const char* policyNames[] = {"catch up", "skip", "rephase"};
+    uint32_t i;
+
+    SF_OSAL_printf("%3s\t%10s\t%8s\t%4s\t%10s\t%8s\t%10s\t%12s\n", "idx", "interval", 
+        "policy", "prio", "executions", "misses", "dl misses", "lateness ms");
+    for(i = 0; deploymentSchedule[i].func; i++)
+    {
+        SF_OSAL_printf("%3lu\t%10lu\t%8s\t%4u\t%10lu\t%8lu\t%10lu\t%12lu\n", i, 
+            deploymentSchedule[i].ensembleInterval, 
+            policyNames[deploymentSchedule[i].overrunPolicy],
+            deploymentSchedule[i].priority,
+            deploymentSchedule[i].measurementCount,
+            deploymentSchedule[i].missCount,
+            deploymentSchedule[i].deadlineMissCount,
+            deploymentSchedule[i].totalLateness);
+    }
+}
+
+void SCH_logStats(DeploymentSchedule_t* deploymentSchedule)
+{
+    uint32_t i;
+
+    for(i = 0; deploymentSchedule[i].func; i++)
+    {
+        if(deploymentSchedule[i].missCount == 0 && 
+            deploymentSchedule[i].deadlineMissCount == 0)
+        {
+            continue;
+        }
+        FLOG_AddError(FLOG_SCH_STATS_ENTRY, i);
+        FLOG_AddError(FLOG_SCH_MISS_COUNT, 
+            (deploymentSchedule[i].missCount > UINT16_MAX) ? UINT16_MAX : deploymentSchedule[i].missCount);
+        FLOG_AddError(FLOG_SCH_LATENESS, 
+            (deploymentSchedule[i].totalLateness > UINT16_MAX) ? UINT16_MAX : deploymentSchedule[i].totalLateness);
+        FLOG_AddError(FLOG_SCH_DEADLINE_MISS, 
+            (deploymentSchedule[i].deadlineMissCount > UINT16_MAX) ? UINT16_MAX : deploymentSchedule[i].deadlineMissCount);
+    }
+}
+
+void SCH_displayTiming(DeploymentSchedule_t* deploymentSchedule)
+{
+    uint32_t i;
+
+    for(i = 0; deploymentSchedule[i].func; i++)
+    {
+        SF_OSAL_printf("Entry %lu, %lu executions\n", i, 
+            deploymentSchedule[i].measurementCount);
+        SCH_displayHistogram("runtime", &deploymentSchedule[i].runtimeHist);
+        SCH_displayHistogram("jitter", &deploymentSchedule[i].jitterHist);
+    }
+}
+
+void SCH_resetTiming(DeploymentSchedule_t* deploymentSchedule)
+{
+    for(; deploymentSchedule->func; deploymentSchedule++)
+    {
+        memset(&deploymentSchedule->runtimeHist, 0, sizeof(SCH_Histogram_t));
+        memset(&deploymentSchedule->jitterHist, 0, sizeof(SCH_Histogram_t));
+    }
+}
+
+uint32_t SCH_getRecordBytes(DeploymentSchedule_t* deploymentSchedule, uint32_t duration_ms)
+{
+    uint32_t nBytes = 0;
+    uint32_t nExecutions;
+
+    for(; deploymentSchedule->func; deploymentSchedule++)
+    {
+        if(deploymentSchedule->ensembleDelay >= duration_ms)
+        {
+            continue;
+        }
+        nExecutions = 1;
+        if(deploymentSchedule->ensembleInterval != UINT32_MAX)
+        {
+            nExecutions += (duration_ms - deploymentSchedule->ensembleDelay) / 
+                deploymentSchedule->ensembleInterval;
+        }
+        if(nExecutions > deploymentSchedule->nMeasurements)
+        {
+            nExecutions = deploymentSchedule->nMeasurements;
+        }
+        nBytes += nExecutions / deploymentSchedule->measurementsToAccumulate * 
+            deploymentSchedule->recordSize;
+    }
+    return nBytes;
+}
+
+/**
+ * @brief Counts a duration in its log2 bucket
+ * 
+ * @param pHist Histogram to update
+ * @param value_us Duration in us
+ */
+static void SCH_addToHistogram(SCH_Histogram_t* pHist, uint32_t value_us)
+{
+    uint32_t bucket = 0;
+
+    if(value_us)
+    {
+        bucket = 32 - __builtin_clz(value_us);
+        if(bucket >= SCH_HIST_N_BUCKETS)
+        {
+            bucket = SCH_HIST_N_BUCKETS - 1;
+        }
+    }
+    pHist->buckets[bucket]++;
+    if(value_us > pHist->max_us)
+    {
+        pHist->max_us = value_us;
+    }
+}
+
+static void SCH_displayHistogram(const char* name, const SCH_Histogram_t* pHist)
+{
+    uint32_t i;
+
+    SF_OSAL_printf("  %s, max %lu us\n", name, pHist->max_us);
+    for(i = 0; i < SCH_HIST_N_BUCKETS; i++)
+    {
+        if(pHist->buckets[i] == 0)
+        {
+            continue;
+        }
+        if(i == 0)
+        {
+            SF_OSAL_printf("  %10s %10lu\t%10lu\n", "", 0UL, pHist->buckets[i]);
+        }
+        else if(i == SCH_HIST_N_BUCKETS - 1)
+        {
+            SF_OSAL_printf("  %10lu %10s\t%10lu\n", 1UL << (i - 1), "+", pHist->buckets[i]);
+        }
+        else
+        {
+            SF_OSAL_printf("  %10lu-%10lu\t%10lu\n", 1UL << (i - 1), (1UL << i) - 1, pHist->buckets[i]);
+        }
+    }
+}
+
+SCH_IdleState_e SCH_idle(system_tick_t wakeTime, SCH_IdleState_e deepestState)
+{
+    system_tick_t idleStart = millis();
+    system_tick_t remaining = 0;
+    system_tick_t wakeAt;
+    SCH_IdleState_e state = SCH_IDLE_YIELD;
+
+    if(wakeTime > idleStart)
+    {
+        remaining = wakeTime - idleStart;
+    }
+    if(deepestState >= SCH_IDLE_SLEEP && remaining >= SCH_IDLE_SLEEP_MIN_MS &&
+        remaining > SCH_sleepLatency)
+    {
+        state = SCH_IDLE_SLEEP;
+    }
+    else if(deepestState >= SCH_IDLE_DELAY && remaining > SCH_IDLE_DELAY_WAKE_LATENCY_MS)
+    {
+        state = SCH_IDLE_DELAY;
+    }
+
+    switch(state)
+    {
+        case SCH_IDLE_SLEEP:
+        {
+            SystemSleepConfiguration sleepConfig;
+            wakeAt = wakeTime - SCH_sleepLatency;
+            sleepConfig.mode(SystemSleepMode::ULTRA_LOW_POWER);
+            sleepConfig.duration(wakeAt - idleStart);
+            System.sleep(sleepConfig);
+            // track the oversleep so the next sleep wakes on time
+            if(millis() > wakeAt)
+            {
+                SCH_sleepLatency = (3 * SCH_sleepLatency + (millis() - wakeAt)) / 4;
+            }
+            break;
+        }
+        case SCH_IDLE_DELAY:
+            remaining -= SCH_IDLE_DELAY_WAKE_LATENCY_MS;
+            delay((remaining > SCH_IDLE_DELAY_MAX_MS) ? SCH_IDLE_DELAY_MAX_MS : remaining);
+            break;
+        default:
+        case SCH_IDLE_YIELD:
+            os_thread_yield();
+            break;
+    }
+    SCH_idleTime[state] += millis() - idleStart;
+    return state;
+}
+
+void SCH_resetIdleStats(void)
+{
+    memset(SCH_idleTime, 0, sizeof(SCH_idleTime));
+    SCH_idleStatsStart = millis();
+}
+
+void SCH_displayIdleStats(void)
+{
+    static const char* stateNames[] = {"yield", "delay", "sleep"};
+    uint32_t elapsed = millis() - SCH_idleStatsStart;
+    uint32_t idleTotal = 0;
+    uint32_t i;
+
+    if(elapsed == 0)
+    {
+        elapsed = 1;
+    }
+    SF_OSAL_printf("%8s\t%10s\t%8s\n", "state", "time ms", "percent");
+    for(i = 0; i < SCH_IDLE_NUM_STATES; i++)
+    {
+        idleTotal += SCH_idleTime[i];
+        SF_OSAL_printf("%8s\t%10lu\t%6lu.%lu\n", stateNames[i], SCH_idleTime[i],
+            (uint32_t)((uint64_t)SCH_idleTime[i] * 100 / elapsed),
+            (uint32_t)((uint64_t)SCH_idleTime[i] * 1000 / elapsed % 10));
+    }
+    SF_OSAL_printf("%8s\t%10lu\t%6lu.%lu\n", "idle", idleTotal,
+        (uint32_t)((uint64_t)idleTotal * 100 / elapsed),
+        (uint32_t)((uint64_t)idleTotal * 1000 / elapsed % 10));
+    SF_OSAL_printf("Sleep wake-up latency: %lu ms\n", SCH_sleepLatency);
+}
+
+/**
+ * @brief Heap ordering: earliest execution time first, then table order
+ *
+ * @param pA First event
+ * @param pB Second event
+ * @return int 1 if pA should execute before pB, otherwise 0
+ */
+static int SCH_isEarlier(const DeploymentSchedule_t* pA, const DeploymentSchedule_t* pB)
+{
+    if(pA->nextExecuteTime != pB->nextExecuteTime)
+    {
+        return pA->nextExecuteTime < pB->nextExecuteTime;
+    }
+    return pA < pB;
+}
+
+/**
+ * @brief EDF ordering: earliest absolute deadline first, then highest
+ * priority, then table order
+ *
+ * @param pA First event
+ * @param pB Second event
+ * @return int 1 if pA should execute before pB, otherwise 0
+ */
+static int SCH_isMoreUrgent(const DeploymentSchedule_t* pA, const DeploymentSchedule_t* pB)
+{
+    size_t deadlineA = SCH_getDeadline(pA);
+    size_t deadlineB = SCH_getDeadline(pB);
+
+    if(deadlineA != deadlineB)
+    {
+        return deadlineA < deadlineB;
+    }
+    if(pA->priority != pB->priority)
+    {
+        return pA->priority > pB->priority;
+    }
+    return pA < pB;
+}
+
+/**
+ * @brief Computes the latest start time of the next execution of an event
+ * 
+ * @param pEvent Event to check
+ * @return size_t Absolute deadline in ms, saturated at SIZE_MAX
+ */
+static size_t SCH_getDeadline(const DeploymentSchedule_t* pEvent)
+{
+    uint32_t relativeDeadline = pEvent->relativeDeadline;
+
+    if(relativeDeadline == 0)
+    {
+        relativeDeadline = pEvent->ensembleInterval;
+    }
+    if(pEvent->nextExecuteTime > SIZE_MAX - relativeDeadline)
+    {
+        return SIZE_MAX;
+    }
+    return pEvent->nextExecuteTime + relativeDeadline;
+}
+
+/**
+ * @brief Moves every pending event that is due into the ready heap
+ * 
+ * @param pQueue Event queue
+ * @param now Current time
+ */
+static void SCH_releaseEvents(SCH_EventQueue_t* pQueue, size_t now)
+{
+    DeploymentSchedule_t* pEvent;
+
+    while(pQueue->nEvents != 0 && pQueue->pHeap[0]->nextExecuteTime <= now)
+    {
+        pEvent = pQueue->pHeap[0];
+        pQueue->nEvents--;
+        pQueue->pHeap[0] = pQueue->pHeap[pQueue->nEvents];
+        SCH_siftDown(pQueue->pHeap, pQueue->nEvents, 0, &SCH_isEarlier);
+
+        pQueue->pReady[pQueue->nReady] = pEvent;
+        SCH_siftUp(pQueue->pReady, pQueue->nReady, &SCH_isMoreUrgent);
+        pQueue->nReady++;
+    }
+}
+
+/**
+ * @brief Retrieves the event that SCH_executeNextEvent would execute
+ * 
+ * @param pQueue Event queue
+ * @return DeploymentSchedule_t* Event, or NULL if there is none
+ */
+static DeploymentSchedule_t* SCH_getCurrentEvent(SCH_EventQueue_t* pQueue)
+{
+    if(pQueue->mode == SCH_DISPATCH_EDF)
+    {
+        return (pQueue->nReady != 0) ? pQueue->pReady[0] : NULL;
+    }
+    return (pQueue->nEvents != 0) ? pQueue->pHeap[0] : NULL;
+}
+
+/**
+ * @brief Checks if the most urgent ready event must wait for a pending one
+ * 
+ * The ready event is deferred if its longest observed runtime would delay
+ * the next pending event, and that event has a higher priority and an
+ * earlier deadline.
+ * 
+ * @param pQueue Event queue in SCH_DISPATCH_EDF mode
+ * @param now Current time
+ * @return int 1 if the ready event must wait, otherwise 0
+ */
+static int SCH_isDeferred(SCH_EventQueue_t* pQueue, size_t now)
+{
+    DeploymentSchedule_t* pReady;
+    DeploymentSchedule_t* pPending;
+
+    if(pQueue->nReady == 0 || pQueue->nEvents == 0)
+    {
+        return 0;
+    }
+    pReady = pQueue->pReady[0];
+    pPending = pQueue->pHeap[0];
+    return pPending->priority > pReady->priority &&
+        SCH_isMoreUrgent(pPending, pReady) &&
+        now + (pReady->runtimeHist.max_us + 999) / 1000 > pPending->nextExecuteTime;
+}
+
+static void SCH_siftUp(DeploymentSchedule_t** pHeap, size_t idx, SCH_HeapOrder isBefore)
+{
+    DeploymentSchedule_t* pEvent = pHeap[idx];
+    size_t parent;
+
+    while(idx > 0)
+    {
+        parent = (idx - 1) / 2;
+        if(!isBefore(pEvent, pHeap[parent]))
+        {
+            break;
+        }
+        pHeap[idx] = pHeap[parent];
+        idx = parent;
+    }
+    pHeap[idx] = pEvent;
+}
+
+static void SCH_siftDown(DeploymentSchedule_t** pHeap, size_t nEvents, size_t idx, SCH_HeapOrder isBefore)
+{
+    DeploymentSchedule_t* pEvent;
+    size_t child;
+
+    if(idx >= nEvents)
+    {
+        return;
+    }
+    pEvent = pHeap[idx];
+    while((child = 2 * idx + 1) < nEvents)
+    {
+        if(child + 1 < nEvents && isBefore(pHeap[child + 1], pHeap[child]))
+        {
+            child++;
+        }
+        if(!isBefore(pHeap[child], pEvent))
+        {
+            break;
+        }
+        pHeap[idx] = pHeap[child];
+        idx = child;
+    }
+    pHeap[idx] = pEvent;
+}
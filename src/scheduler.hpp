@@ -3,8 +3,67 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <Particle.h>
+#include "product.hpp"
 typedef struct DeploymentSchedule_ DeploymentSchedule_t;
 
+/**
+ * @brief Maximum number of entries in a deployment schedule
+ * 
+ * This sizes the event queue, not the schedule tables themselves.
+ */
+#ifndef SCH_MAX_SCHEDULE_LEN
+#define SCH_MAX_SCHEDULE_LEN    32
+#endif
+
+#define SCH_IDLE_DELAY_WAKE_LATENCY_MS  SF_IDLE_DELAY_WAKE_LATENCY_MS
+#define SCH_IDLE_DELAY_MAX_MS           SF_IDLE_DELAY_MAX_MS
+#define SCH_IDLE_SLEEP_WAKE_LATENCY_MS  SF_IDLE_SLEEP_WAKE_LATENCY_MS
+#define SCH_IDLE_SLEEP_MIN_MS           SF_IDLE_SLEEP_MIN_MS
+
+/**
+ * @brief Idle states, from shallowest to deepest
+ * 
+ */
+typedef enum SCH_IdleState_
+{
+    /**
+     * @brief Yield to other threads, then return
+     */
+    SCH_IDLE_YIELD,
+    /**
+     * @brief Block the thread with delay()
+     * 
+     * The MCU idles in WFI, and UARTs keep receiving into their buffers.
+     */
+    SCH_IDLE_DELAY,
+    /**
+     * @brief ULTRA_LOW_POWER sleep with a timed wake
+     * 
+     * UARTs are not serviced in this state, so callers that stream from the
+     * GPS must not go deeper than SCH_IDLE_DELAY.
+     */
+    SCH_IDLE_SLEEP,
+    SCH_IDLE_NUM_STATES
+}SCH_IdleState_e;
+
+/**
+ * @brief Number of log2 buckets in an ensemble timing histogram
+ * 
+ * Bucket 0 counts 0 us, bucket i counts [2^(i-1), 2^i) us, and the last bucket
+ * also counts everything longer.
+ */
+#define SCH_HIST_N_BUCKETS  24
+
+/**
+ * @brief Log2 histogram of a duration in us
+ * 
+ */
+typedef struct SCH_Histogram_
+{
+    uint32_t buckets[SCH_HIST_N_BUCKETS];
+    uint32_t max_us;
+}SCH_Histogram_t;
+
 /**
  * @brief Ensemble function.
  * 
@@ -26,10 +85,77 @@ typedef void (*EnsembleFunction)(DeploymentSchedule_t* pDeployment);
  */
 typedef void (*EnsembleInit)(DeploymentSchedule_t* pDeployment);
 
+/**
+ * @brief Sensor acquisition function.
+ * 
+ * Takes one shared reading of the sensors for all ensembles due on the same
+ * tick.
+ * 
+ * @param tickTime Scheduled time of the tick
+ */
+typedef void (*SCH_AcquireFunction)(system_tick_t tickTime);
+
+/**
+ * @brief Overrun policy
+ * 
+ * Selects what the scheduler does when an ensemble starts late enough that
+ * one or more of its slots have already passed.
+ */
+typedef enum SCH_OverrunPolicy_
+{
+    /**
+     * @brief Execute every missed slot back to back until caught up
+     */
+    SCH_OVERRUN_CATCH_UP = 0,
+    /**
+     * @brief Drop the missed slots and stay on the original time grid
+     */
+    SCH_OVERRUN_SKIP,
+    /**
+     * @brief Restart the time grid from the late execution
+     */
+    SCH_OVERRUN_REPHASE,
+}SCH_OverrunPolicy_e;
+
+/**
+ * @brief Dispatch mode
+ * 
+ */
+typedef enum SCH_DispatchMode_
+{
+    /**
+     * @brief Execute events in order of next execution time, then table order
+     */
+    SCH_DISPATCH_TIME = 0,
+    /**
+     * @brief Earliest deadline first
+     * 
+     * Of the events that are due, execute the one with the earliest absolute
+     * deadline, then the highest priority.  A due event is deferred if its
+     * longest observed runtime would delay a more urgent, higher priority
+     * event that is about to be released.
+     */
+    SCH_DISPATCH_EDF,
+}SCH_DispatchMode_e;
+
+/**
+ * @brief Schedule table entry
+ * 
+ * Build entries with SCH_ensembleEntry (scheduleTable.hpp), which checks the
+ * ensemble parameters at compile time.
+ * 
+ */
 struct DeploymentSchedule_
 {
     EnsembleFunction func;
     EnsembleInit init;
+    /**
+     * @brief Number of executions accumulated into each recorded ensemble
+     * 
+     * Ensembles oversample by executing at a short interval and recording
+     * every measurementsToAccumulate executions.
+     * 
+     */
     size_t measurementsToAccumulate;
     uint32_t ensembleDelay;
     /**
@@ -51,9 +177,251 @@ struct DeploymentSchedule_
     uint32_t measurementCount;
 
     void* pData;
+    SCH_OverrunPolicy_e overrunPolicy;
+    /**
+     * @brief Set if the ensemble reads the shared sensor snapshot
+     * 
+     * The snapshot is only acquired for the execution that completes a
+     * record, so oversampled ensembles must only read it then.
+     * 
+     */
+    uint8_t usesSnapshot;
+    /**
+     * @brief EDF priority, higher values win ties and are not deferred for
+     * lower values
+     * 
+     */
+    uint8_t priority;
+    /**
+     * @brief Time after each scheduled time by which the ensemble must start
+     * (ms)
+     * 
+     * Set to 0 to use ensembleInterval.
+     * 
+     */
+    uint32_t relativeDeadline;
+    /**
+     * @brief Length of the largest record the ensemble records, including the
+     * ensemble header, in bytes
+     * 
+     */
+    uint32_t recordSize;
+
+    /**
+     * @brief Next execution time in ms, maintained by the event queue
+     *
+     * Initialize this and the following statistics to 0 in the schedule
+     * table initializers.
+     *
+     */
+    size_t nextExecuteTime;
+    /**
+     * @brief Number of slots this ensemble started late by
+     * 
+     * An execution that starts n intervals after its scheduled time counts as
+     * n misses.
+     */
+    uint32_t missCount;
+    /**
+     * @brief Sum of start time minus scheduled time over all executions (ms)
+     * 
+     */
+    uint32_t totalLateness;
+    /**
+     * @brief Number of executions that started after their deadline
+     * 
+     */
+    uint32_t deadlineMissCount;
+    /**
+     * @brief micros() at startTime, used to time the schedule in us
+     * 
+     */
+    uint32_t startMicros;
+    /**
+     * @brief Histogram of ensemble function execution time
+     * 
+     */
+    SCH_Histogram_t runtimeHist;
+    /**
+     * @brief Histogram of ensemble function start time minus scheduled time
+     * 
+     */
+    SCH_Histogram_t jitterHist;
 };
 
+/**
+ * @brief Event queue
+ *
+ * Binary min-heap of schedule entries keyed by next execution time.  Ties are
+ * broken by table order, so the queue dispatches events in the same order as
+ * SCH_getNextEvent.
+ * 
+ * In SCH_DISPATCH_EDF mode, events that are due move to a second heap keyed
+ * by absolute deadline, from which they are dispatched.
+ */
+typedef struct SCH_EventQueue_
+{
+    DeploymentSchedule_t* pHeap[SCH_MAX_SCHEDULE_LEN];
+    size_t nEvents;
+    DeploymentSchedule_t* pReady[SCH_MAX_SCHEDULE_LEN];
+    size_t nReady;
+    SCH_DispatchMode_e mode;
+    DeploymentSchedule_t* pSchedule;
+    /**
+     * @brief Sensor acquisition function, or NULL to disable snapshots
+     * 
+     */
+    SCH_AcquireFunction acquire;
+    /**
+     * @brief Events due within this many ms of the last acquisition share it
+     * 
+     */
+    uint32_t acquireWindow;
+    /**
+     * @brief Scheduled time of the last acquisition
+     * 
+     */
+    size_t lastAcquireTime;
+    uint8_t hasAcquired;
+}SCH_EventQueue_t;
+
 void SCH_initializeSchedule(DeploymentSchedule_t* pDeployment, system_tick_t startTime);
 void SCH_getNextEvent(DeploymentSchedule_t* deploymentSchedule, DeploymentSchedule_t ** pEventPtr, size_t* pNextTime);
 
+/**
+ * @brief Builds the event queue from an initialized schedule table
+ *
+ * @param pQueue Queue to build
+ * @param deploymentSchedule NULL terminated schedule table
+ * @return int 1 if successful, 0 if the table has more than
+ * SCH_MAX_SCHEDULE_LEN entries
+ */
+int SCH_initializeQueue(SCH_EventQueue_t* pQueue, DeploymentSchedule_t* deploymentSchedule);
+
+/**
+ * @brief Enables the per-tick sensor snapshot stage
+ * 
+ * Before an event with usesSnapshot set executes, acquire is called unless an
+ * acquisition was already made for a tick no more than window ms earlier.
+ * Call this after SCH_initializeQueue.
+ * 
+ * @param pQueue Event queue
+ * @param acquire Sensor acquisition function
+ * @param window Window in ms over which ensembles share one acquisition
+ */
+void SCH_setAcquisition(SCH_EventQueue_t* pQueue, SCH_AcquireFunction acquire, uint32_t window);
+
+/**
+ * @brief Selects the dispatch mode
+ * 
+ * Call this after SCH_initializeQueue.
+ * 
+ * @param pQueue Event queue
+ * @param mode Dispatch mode
+ */
+void SCH_setDispatchMode(SCH_EventQueue_t* pQueue, SCH_DispatchMode_e mode);
+
+/**
+ * @brief Retrieves the next event from the event queue without removing it
+ *
+ * In SCH_DISPATCH_EDF mode, the event executed by SCH_executeNextEvent is
+ * chosen when it is called, and may differ from the one returned here.
+ * 
+ * @param pQueue Event queue
+ * @param pEventPtr Set to the next event, or NULL if no events remain
+ * @param pNextTime Set to the time to wait until before executing
+ */
+void SCH_peekNextEvent(SCH_EventQueue_t* pQueue, DeploymentSchedule_t** pEventPtr, size_t* pNextTime);
+
+/**
+ * @brief Executes the next event and reschedules it
+ * 
+ * The caller is responsible for waiting until the next event is due.  In
+ * SCH_DISPATCH_EDF mode, nothing is executed if the due event is deferred.
+ *
+ * @param pQueue Event queue
+ */
+void SCH_executeNextEvent(SCH_EventQueue_t* pQueue);
+
+/**
+ * @brief Records the execution of the current event and reschedules it
+ *
+ * This must be called once after each call to the current event's ensemble
+ * function.  The current event is the root of the event queue, or in
+ * SCH_DISPATCH_EDF mode the most urgent event that is due.  Lateness is
+ * accounted and the next execution time is chosen according to the event's
+ * overrun policy.  The event is removed from the queue once it has no
+ * executions left.
+ *
+ * @param pQueue Event queue
+ * @param startTime Time the ensemble function was started
+ */
+void SCH_rescheduleEvent(SCH_EventQueue_t* pQueue, system_tick_t startTime);
+
+/**
+ * @brief Prints the miss, deadline and lateness statistics of a schedule
+ * 
+ * @param deploymentSchedule NULL terminated schedule table
+ */
+void SCH_displayStats(DeploymentSchedule_t* deploymentSchedule);
+
+/**
+ * @brief Records the miss statistics of a schedule in the fault log
+ * 
+ * @param deploymentSchedule NULL terminated schedule table
+ */
+void SCH_logStats(DeploymentSchedule_t* deploymentSchedule);
+
+/**
+ * @brief Prints the execution time and start jitter histograms of a schedule
+ * 
+ * @param deploymentSchedule NULL terminated schedule table
+ */
+void SCH_displayTiming(DeploymentSchedule_t* deploymentSchedule);
+
+/**
+ * @brief Clears the execution time and start jitter histograms of a schedule
+ * 
+ * @param deploymentSchedule NULL terminated schedule table
+ */
+void SCH_resetTiming(DeploymentSchedule_t* deploymentSchedule);
+
+/**
+ * @brief Returns the most bytes of records a schedule records in a duration
+ * 
+ * Counts every ensemble at its largest record size, before the recorder
+ * encodes or compresses it.
+ * 
+ * @param deploymentSchedule NULL terminated schedule table
+ * @param duration_ms Time from the start of the schedule in ms
+ * @return uint32_t Bytes of records
+ */
+uint32_t SCH_getRecordBytes(DeploymentSchedule_t* deploymentSchedule, uint32_t duration_ms);
+
+/**
+ * @brief Idles until the specified time or for one idle step
+ * 
+ * Picks the deepest idle state, no deeper than deepestState, whose wake-up
+ * latency fits in the time remaining, and idles in it once.  Call this in a
+ * loop until the wake time, servicing peripherals between steps.
+ * 
+ * @param wakeTime Time to be awake by
+ * @param deepestState Deepest idle state that is safe for the caller
+ * @return SCH_IdleState_e Idle state that was used
+ */
+SCH_IdleState_e SCH_idle(system_tick_t wakeTime, SCH_IdleState_e deepestState);
+
+/**
+ * @brief Clears the idle time accounting
+ * 
+ */
+void SCH_resetIdleStats(void);
+
+/**
+ * @brief Prints the fraction of time spent in each idle state since the last
+ * SCH_resetIdleStats
+ * 
+ */
+void SCH_displayIdleStats(void);
+
 #endif
\ No newline at end of file
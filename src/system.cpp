@@ -6,7 +6,9 @@
 #include "max31725.h"
 
 static SpiFlashMacronix DP_spiFlash(SPI1, D5);
-SpiffsParticle DP_fs(DP_spiFlash);
+static SpiFlashPowerManager DP_flashPower(DP_spiFlash);
+static SpiFlashPageBuffer DP_flash(DP_flashPower);
+SpiffsParticle DP_fs(DP_flash);
 static PMIC pmic;
 FuelGauge battery;
 static WaterSensor waterSensor(WATER_DETECT_EN_PIN, WATER_DETECT_PIN, 
@@ -27,9 +29,11 @@ AK09916 SF_mag(SF_AK09916_ADDR);
 static void SYS_chargerTask(void);
 static void SYS_waterTask(void);
 static void SYS_batteryTask(void);
+static void SYS_flashPowerTask(void);
 static Timer chargerTimer(SYS_CHARGER_REFRESH_MS, SYS_chargerTask, false);
 static Timer waterTimer(SYS_WATER_REFRESH_MS, SYS_waterTask, false);
 static Timer batteryMonitorTimer(SYS_BATTERY_MONITOR_MS, SYS_batteryTask, false);
+static Timer flashPowerTimer(SYS_FLASH_POWER_CHECK_MS, SYS_flashPowerTask, false);
 static LEDSystemTheme ledTheme;
 
 char SYS_deviceID[32];
@@ -68,10 +72,13 @@ int SYS_initSys(void)
 
 static int SYS_initFS(void)
 {
-    DP_spiFlash.begin();
+    DP_flashPower.withIdleTimeMs(SF_FLASH_POWER_DOWN_IDLE_MS);
+    DP_flash.begin();
     DP_fs.withPhysicalAddr(SF_FLASH_SIZE_MB * 1024 * 1024);
     DP_fs.mount();
     systemDesc.pFileSystem = &DP_fs;
+    systemDesc.pFlashPower = &DP_flashPower;
+    flashPowerTimer.start();
 
     dataRecorder.init();
     systemDesc.pRecorder = &dataRecorder;
@@ -81,8 +88,9 @@ static int SYS_initFS(void)
 int SYS_deinitSys(void)
 {
     Cellular.off();
+    flashPowerTimer.stop();
     DP_fs.unmount();
-    DP_spiFlash.deepPowerDown();
+    DP_flashPower.deepPowerDown();
     return 1;
 }
 
@@ -192,6 +200,16 @@ static void SYS_chargerTask(void)
         systemDesc.pChargerCheck->stopFromISR();
     }
 }
+/**
+ * @brief Puts the flash in deep power down once it has been idle for
+ * SF_FLASH_POWER_DOWN_IDLE_MS
+ * 
+ */
+static void SYS_flashPowerTask(void)
+{
+    DP_flashPower.process();
+}
+
 static void SYS_waterTask(void)
 {
     // TODO fix this to be the one polling for wet/dry hysteresis.
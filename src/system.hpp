@@ -18,6 +18,7 @@
 #define SYS_CHARGER_REFRESH_MS  500
 #define SYS_WATER_REFRESH_MS    1000
 #define SYS_BATTERY_MONITOR_MS  1000
+#define SYS_FLASH_POWER_CHECK_MS    SF_FLASH_POWER_DOWN_IDLE_MS
 
 typedef volatile struct SystemFlags_
 {
@@ -29,6 +30,7 @@ typedef volatile struct SystemFlags_
 typedef struct SystemDesc_
 {
     SpiffsParticle* pFileSystem;
+    SpiFlashPowerManager* pFlashPower;
     PMIC* pmic;
     FuelGauge* pBattery;
     NVRAM* pNvram;
@@ -8,40 +8,64 @@
 #include "ensembleTypes.hpp"
 #include "utils.hpp"
 #include "scheduler.hpp"
+#include "scheduleTable.hpp"
+#include "ensembleAccumulator.hpp"
 #include "flog.hpp"
 #include "sleepTask.hpp"
 
-typedef struct Ensemble08_eventData_
-{
-    double temperature;
-    int32_t water;
-
-    uint32_t accumulateCount;
-}Ensemble08_eventData_t;
-
-typedef struct Ensemble07_eventData_
-{
-    float battVoltage;
-    uint32_t accumulateCount;
-}Ensemble07_eventData_t;
+/**
+ * @brief Raw temperature and water
+ * 
+ */
+typedef EnsembleAccumulator<int16_t, uint8_t> Ensemble08_eventData_t;
+/**
+ * @brief Battery voltage in mV
+ * 
+ */
+typedef EnsembleAccumulator<uint16_t> Ensemble07_eventData_t;
 
 static LEDStatus TCAL_ledStatus;
-static Ensemble07_eventData_t ensemble07Data;
-static Ensemble08_eventData_t ensemble08Data;
 
-static void SS_ensemble07Func(DeploymentSchedule_t* pDeployment);
-static void SS_ensemble07Init(DeploymentSchedule_t* pDeployment);
+/**
+ * @brief Ensemble 07 - Battery every 10 seconds
+ * 
+ * nMeasurements is set from NVRAM when calibration starts.
+ */
+struct TCAL_Ensemble07 : SCH_EnsembleDefaults
+{
+    typedef Ensemble07_eventData_t Accumulator;
+    typedef Ensemble07_data_t Record;
+    static constexpr uint32_t ensembleInterval = 10000;
+    static constexpr SCH_OverrunPolicy_e overrunPolicy = SCH_OVERRUN_REPHASE;
+    static constexpr uint8_t priority = 1;
+    static void execute(Accumulator& accumulator, DeploymentSchedule_t* pDeployment);
+};
 
-static void SS_ensemble08Func(DeploymentSchedule_t* pDeployment);
-static void SS_ensemble08Init(DeploymentSchedule_t* pDeployment);
+/**
+ * @brief Ensemble 08 - Temperature every second
+ * 
+ * nMeasurements is set from NVRAM when calibration starts.
+ */
+struct TCAL_Ensemble08 : SCH_EnsembleDefaults
+{
+    typedef Ensemble08_eventData_t Accumulator;
+    typedef Ensemble08_data_t Record;
+    static constexpr uint32_t ensembleInterval = 1000;
+    static constexpr SCH_OverrunPolicy_e overrunPolicy = SCH_OVERRUN_SKIP;
+    static constexpr uint8_t usesSnapshot = 1;
+    static constexpr uint8_t priority = 2;
+    static void execute(Accumulator& accumulator, DeploymentSchedule_t* pDeployment);
+};
 
 DeploymentSchedule_t calibrateSchedule[] =
 {
-    // Func              init               acc del int,  total_meas  las start count members
-    {&SS_ensemble07Func, &SS_ensemble07Init, 1, 0, 10000, UINT32_MAX, 0, 0, 0, &ensemble07Data},
-    {&SS_ensemble08Func, &SS_ensemble08Init, 1, 0, 1000, UINT32_MAX, 0, 0, 0, &ensemble08Data},
-    {NULL, NULL, 0, 0, 0, 0, 0, 0, 0, NULL}
+    SCH_ensembleEntry<TCAL_Ensemble07>(),
+    SCH_ensembleEntry<TCAL_Ensemble08>(),
+    SCH_END_OF_SCHEDULE
 };
+SCH_CHECK_SCHEDULE_LENGTH(calibrateSchedule);
+
+static SCH_EventQueue_t calibrateQueue;
 
 void TemperatureCal::init(void)
 {
@@ -82,6 +106,7 @@ STATES_e TemperatureCal::run(void)
     
     FLOG_AddError(FLOG_CAL_START_RUN, 0);
     FLOG_AddError(FLOG_CAL_LIMIT, this->burstLimit);
+    SCH_resetIdleStats();
     for(burstIdx = 0; burstIdx < this->burstLimit; burstIdx++)
     {
         burstStart = millis();
@@ -90,24 +115,31 @@ STATES_e TemperatureCal::run(void)
         this->startTime = millis();
         FLOG_AddError(FLOG_CAL_BURST, burstIdx);
         SCH_initializeSchedule(calibrateSchedule, this->startTime);
+        SCH_initializeQueue(&calibrateQueue, calibrateSchedule);
+        SCH_setAcquisition(&calibrateQueue, &RIDE_acquireSnapshot, RIDE_SNAPSHOT_WINDOW_MS);
         while(millis() - burstStart < this->measurementTime_s * 1e3)
         {
-            SCH_getNextEvent(calibrateSchedule, &pNextEvent, &nextEventTime);
+            SCH_peekNextEvent(&calibrateQueue, &pNextEvent, &nextEventTime);
+            if(NULL == pNextEvent)
+            {
+                break;
+            }
             while(millis() < nextEventTime)
             {
+                // samples are printed over USB serial, which sleep suspends
+                SCH_idle(nextEventTime, SCH_IDLE_DELAY);
             }
 
-            pNextEvent->func(pNextEvent);
-            pNextEvent->lastExecuteTime = nextEventTime;
-            pNextEvent->measurementCount++;
+            SCH_executeNextEvent(&calibrateQueue);
             SF_OSAL_printf("%lu\n", millis() - burstStart);
         }
 
         
+        SCH_logStats(calibrateSchedule);
         burstEnd = millis();
         sleepTime = (nextBurst - burstEnd);
         FLOG_AddError(FLOG_CAL_SLEEP, sleepTime);
-        UTIL_sleepUntil(nextBurst);
+        UTIL_sleepUntil(nextBurst, SCH_IDLE_DELAY);
     }
     FLOG_AddError(FLOG_CAL_DONE, 0);
     return STATE_CLI;
@@ -121,89 +153,54 @@ void TemperatureCal::exit(void)
 
 }
 
-static void SS_ensemble07Init(DeploymentSchedule_t* pDeployment)
+void TCAL_Ensemble07::execute(Accumulator& accumulator, DeploymentSchedule_t* pDeployment)
 {
-    memset(&ensemble07Data, 0, sizeof(Ensemble07_eventData_t));
-    pDeployment->pData = &ensemble07Data;
-}
+    uint8_t* pBuffer;
 
-static void SS_ensemble08Init(DeploymentSchedule_t* pDeployment)
-{
-    memset(&ensemble08Data, 0, sizeof(Ensemble08_eventData_t));
-    pDeployment->pData = &ensemble08Data;
-}
-
-static void SS_ensemble07Func(DeploymentSchedule_t* pDeployment)
-{
-    float battVoltage;
-    Ensemble07_eventData_t* pData = (Ensemble07_eventData_t*) pDeployment->pData;
-    #pragma pack(push, 1)
-    struct{
-        EnsembleHeader_t header;
-        Ensemble07_data_t data;
-    }ensData;
-    #pragma pack(pop)
-
-    // obtain measurements
-    battVoltage = pSystemDesc->pBattery->getVCell();
-
-    // accumulate measurements
-    pData->battVoltage += battVoltage;
-    pData->accumulateCount++;
+    // obtain and accumulate measurements
+    accumulator.add(pSystemDesc->pBattery->getVCell() * 1000);
 
     // Report accumulated measurements
-    if(pData->accumulateCount == pDeployment->measurementsToAccumulate)
+    if(accumulator.getCount() == measurementsToAccumulate)
     {
-        ensData.header.elapsedTime_ds = Ens_getStartTime(pDeployment->startTime);
-        ensData.header.ensembleType = ENS_BATT;
-        ensData.data.batteryVoltage = N_TO_B_ENDIAN_2((pData->battVoltage / pData->accumulateCount) * 1000);
-
-        pSystemDesc->pRecorder->putData(ensData);
-        memset(pData, 0, sizeof(Ensemble07_eventData_t));
+        pBuffer = (uint8_t*) pSystemDesc->pRecorder->reserveBytes(sizeof(EnsembleHeader_t) + sizeof(Ensemble07_data_t));
+        if(pBuffer)
+        {
+            pBuffer = Ens_putHeader(pBuffer, ENS_BATT, pDeployment->startTime);
+            accumulator.putMeans(pBuffer);
+        }
+        accumulator.reset();
     }
-
 }
 
-static void SS_ensemble08Func(DeploymentSchedule_t* pDeployment)
+void TCAL_Ensemble08::execute(Accumulator& accumulator, DeploymentSchedule_t* pDeployment)
 {
-    float temp;
-    uint8_t water;
-
-    Ensemble08_eventData_t* pData = (Ensemble08_eventData_t*) pDeployment->pData;
-    #pragma pack(push, 1)
-    struct{
-        EnsembleHeader_t header;
-        Ensemble08_data_t ensData;
-    }ens;
-    #pragma pack(pop)
+    int16_t rawTemp;
+    uint8_t* pBuffer;
+
     SF_OSAL_printf("Do Temp at %lu\n", millis());
     FLOG_AddError(FLOG_CAL_TEMP, pDeployment->measurementCount);
 
-    // obtain measurements
-    temp = pSystemDesc->pTempSensor->getTemp();
-    water = pSystemDesc->pWaterSensor->getCurrentReading();
-
-    // accumulate measurements
-    pData->temperature += temp;
-    pData->water += water;
-    pData->accumulateCount++;
+    // obtain and accumulate measurements
+    accumulator.add(RIDE_snapshot.temperature / RIDE_TEMP_RESOLUTION, RIDE_snapshot.water);
 
     // Report accumulated measurements
-    if(pData->accumulateCount == pDeployment->measurementsToAccumulate)
+    if(accumulator.getCount() == measurementsToAccumulate)
     {
-        water = pData->water / pDeployment->measurementsToAccumulate;
-        temp = pData->temperature / pDeployment->measurementsToAccumulate;
-        if(water == false)
+        rawTemp = accumulator.getMean<0>();
+        if(!accumulator.getMean<1>())
         {
-            temp -= 100;
+            rawTemp += RIDE_TEMP_DRY_OFFSET;
         }
-        
-        ens.header.elapsedTime_ds = Ens_getStartTime(pDeployment->startTime);
-        ens.header.ensembleType = ENS_TEMP_TIME;
-        ens.ensData.rawTemp = N_TO_B_ENDIAN_2(temp / 0.0078125);
 
-        pSystemDesc->pRecorder->putData(ens);
-        memset(pData, 0, sizeof(Ensemble08_eventData_t));
+        pBuffer = (uint8_t*) pSystemDesc->pRecorder->reserveBytes(sizeof(EnsembleHeader_t) + sizeof(Ensemble08_data_t));
+        if(pBuffer)
+        {
+            pBuffer = Ens_putHeader(pBuffer, ENS_TEMP_TIME, pDeployment->startTime);
+            pBuffer = Ens_putBigEndian(pBuffer, rawTemp);
+            // timestamp is not used
+            pBuffer = Ens_putBigEndian<uint32_t>(pBuffer, 0);
+        }
+        accumulator.reset();
     }
-
-}
\ No newline at end of file
+}
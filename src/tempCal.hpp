@@ -7,12 +7,15 @@
 #include <Particle.h>
 #include "product.hpp"
 #include "system.hpp"
+#include "scheduler.hpp"
 
 #define TCAL_RGB_LED_COLOR      SF_TCAL_RGB_LED_COLOR
 #define TCAL_RGB_LED_PATTERN    SF_TCAL_RGB_LED_PATTERN
 #define TCAL_RGB_LED_PERIOD     SF_TCAL_RGB_LED_PERIOD
 #define TCAL_RGB_LED_PRIORITY   SF_TCAL_RGB_LED_PRIORITY
 
+extern DeploymentSchedule_t calibrateSchedule[];
+
 class TemperatureCal : public Task {
     public:
     void init(void);
@@ -3,7 +3,9 @@
 #include "Particle.h"
 #include <cstring>
 
-void UTIL_sleepUntil(system_tick_t ticks)
+#include "scheduler.hpp"
+
+void UTIL_sleepUntil(system_tick_t ticks, SCH_IdleState_e mode)
 {
     system_tick_t now = millis();
     if(ticks <= now)
@@ -11,17 +13,9 @@ void UTIL_sleepUntil(system_tick_t ticks)
         // late!
         return;
     }
-    // if(ticks - now < 30000)
-    // {
-    //     SystemSleepConfiguration sleepConfig;
-    //     sleepConfig.mode(SystemSleepMode::ULTRA_LOW_POWER);
-    //     sleepConfig.duration(ticks - now);
-    //     System.sleep(sleepConfig);
-    //     return;
-    // }
     while(millis() < ticks)
     {
-
+        SCH_idle(ticks, mode);
     }
     return;
 }
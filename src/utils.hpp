@@ -3,12 +3,22 @@
 
 #include <stdint.h>
 #include <Particle.h>
+#include "scheduler.hpp"
 #define N_TO_B_ENDIAN_2(x)  ((((uint16_t)(x) & 0x00FF) << 8) | (((uint16_t)(x) & 0xFF00) >> 8))
 #define N_TO_B_ENDIAN_4(x)  ((((uint32_t)(x) & 0x000000FF) << 24) | (((uint32_t)(x) & 0x0000FF00) << 8) | (((uint32_t)(x) & 0x00FF0000) >> 8) | (((uint32_t)(x) & 0xFF000000) >> 24))
 
 #define B_TO_N_ENDIAN_2(x)  N_TO_B_ENDIAN_2(x)
 #define B_TO_N_ENDIAN_4(x)  N_TO_B_ENDIAN_4(x)
 
-void UTIL_sleepUntil(system_tick_t ticks);
+/**
+ * @brief Idles until the given time
+ * 
+ * SCH_IDLE_SLEEP suspends USB serial, so pass SCH_IDLE_DELAY while the CLI
+ * or USB serial is in use.
+ * 
+ * @param ticks millis() to idle until
+ * @param mode Deepest idle state to use
+ */
+void UTIL_sleepUntil(system_tick_t ticks, SCH_IdleState_e mode = SCH_IDLE_SLEEP);
 
 #endif
\ No newline at end of file